@@ -1066,6 +1066,7 @@ void blk_start_plug_nr_ios(struct blk_plug *plug, unsigned short nr_ios)
 	plug->multiple_queues = false;
 	plug->has_elevator = false;
 	plug->nowait = false;
+	plug->sort_merge = false;
 	INIT_LIST_HEAD(&plug->cb_list);
 
 	/*
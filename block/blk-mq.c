@@ -12,6 +12,7 @@
 #include <linux/blkdev.h>
 #include <linux/blk-integrity.h>
 #include <linux/kmemleak.h>
+#include <linux/list_sort.h>
 #include <linux/mm.h>
 #include <linux/init.h>
 #include <linux/slab.h>
@@ -1298,6 +1299,10 @@ static void blk_add_rq_to_plug(struct blk_plug *plug, struct request *rq)
 		plug->multiple_queues = true;
 	if (!plug->has_elevator && (rq->rq_flags & RQF_ELV))
 		plug->has_elevator = true;
+	/* an I/O scheduler sorts and merges on insertion already */
+	if (!plug->sort_merge && blk_queue_plug_merge(rq->q) &&
+	    !rq->q->elevator)
+		plug->sort_merge = true;
 	rq->rq_next = NULL;
 	rq_list_add(&plug->mq_list, rq);
 	plug->rq_count++;
@@ -2759,7 +2764,8 @@ static void __blk_mq_flush_plug_list(struct request_queue *q,
 	q->mq_ops->queue_rqs(&plug->mq_list);
 }
 
-static void blk_mq_dispatch_plug_list(struct blk_plug *plug, bool from_sched)
+static void blk_mq_dispatch_plug_list(struct blk_plug *plug, bool from_sched,
+				      bool sorted)
 {
 	struct blk_mq_hw_ctx *this_hctx = NULL;
 	struct blk_mq_ctx *this_ctx = NULL;
@@ -2778,7 +2784,14 @@ static void blk_mq_dispatch_plug_list(struct blk_plug *plug, bool from_sched)
 			rq_list_add_tail(&requeue_lastp, rq);
 			continue;
 		}
-		list_add(&rq->queuelist, &list);
+		/*
+		 * The plug list is in reverse submission order unless it was
+		 * sorted by blk_mq_plug_sort_merge(), keep the sort ascending.
+		 */
+		if (sorted)
+			list_add_tail(&rq->queuelist, &list);
+		else
+			list_add(&rq->queuelist, &list);
 		depth++;
 	} while (!rq_list_empty(plug->mq_list));
 
@@ -2787,9 +2800,62 @@ static void blk_mq_dispatch_plug_list(struct blk_plug *plug, bool from_sched)
 	blk_mq_sched_insert_requests(this_hctx, this_ctx, &list, from_sched);
 }
 
+static int plug_rq_cmp(void *priv, const struct list_head *a,
+		       const struct list_head *b)
+{
+	struct request *rqa = container_of(a, struct request, queuelist);
+	struct request *rqb = container_of(b, struct request, queuelist);
+
+	if (rqa->mq_hctx != rqb->mq_hctx)
+		return rqa->mq_hctx > rqb->mq_hctx;
+	return blk_rq_pos(rqa) > blk_rq_pos(rqb);
+}
+
+static bool blk_mq_plug_can_merge(struct request *rq, struct request *next)
+{
+	struct request_queue *q = rq->q;
+
+	if (next->q != q || !blk_queue_plug_merge(q) || blk_queue_nomerges(q))
+		return false;
+	/* an I/O scheduler merges on insertion and tracks its own requests */
+	if (q->elevator)
+		return false;
+	return blk_rq_pos(rq) + blk_rq_sectors(rq) == blk_rq_pos(next);
+}
+
+/*
+ * Sort the plugged requests by hardware queue and start sector, and merge
+ * the ones that turned out to be contiguous.  Requests from several threads
+ * or from out of order submission end up plugged in an arbitrary order, and
+ * the bio merge done at plug time only ever looks at the last request.
+ */
+static void blk_mq_plug_sort_merge(struct blk_plug *plug)
+{
+	struct request *rq, *next, *tmp;
+	struct request **lastp = &plug->mq_list;
+	LIST_HEAD(list);
+
+	while ((rq = rq_list_pop(&plug->mq_list)))
+		list_add_tail(&rq->queuelist, &list);
+	list_sort(NULL, &list, plug_rq_cmp);
+
+	rq = NULL;
+	list_for_each_entry_safe(next, tmp, &list, queuelist) {
+		list_del_init(&next->queuelist);
+		if (rq && blk_mq_plug_can_merge(rq, next) &&
+		    blk_attempt_req_merge(rq->q, rq, next)) {
+			blk_mq_free_request(next);
+			continue;
+		}
+		rq = next;
+		rq_list_add_tail(&lastp, rq);
+	}
+}
+
 void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 {
 	struct request *rq;
+	bool sort_merge;
 
 	/*
 	 * We may have been called recursively midway through handling
@@ -2800,7 +2866,12 @@ void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 	 */
 	if (plug->rq_count == 0)
 		return;
+	sort_merge = plug->sort_merge && plug->rq_count > 1;
 	plug->rq_count = 0;
+	plug->sort_merge = false;
+
+	if (sort_merge)
+		blk_mq_plug_sort_merge(plug);
 
 	if (!plug->multiple_queues && !plug->has_elevator && !from_schedule) {
 		struct request_queue *q;
@@ -2833,7 +2904,7 @@ void blk_mq_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 	}
 
 	do {
-		blk_mq_dispatch_plug_list(plug, from_schedule);
+		blk_mq_dispatch_plug_list(plug, from_schedule, sort_merge);
 	} while (!rq_list_empty(plug->mq_list));
 }
 
@@ -4304,6 +4375,7 @@ int blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 	 * Default to classic polling
 	 */
 	q->poll_nsec = BLK_MQ_POLL_CLASSIC;
+	q->poll_hybrid_pct = BLK_MQ_POLL_HYBRID_PCT;
 
 	blk_mq_init_cpu_queues(q, set->nr_hw_queues);
 	blk_mq_add_queue_tag_set(set, q);
@@ -4837,7 +4909,8 @@ static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb)
 static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 				       struct request *rq)
 {
-	unsigned long ret = 0;
+	struct blk_rq_stat *stat;
+	u64 nsecs, now;
 	int bucket;
 
 	/*
@@ -4848,22 +4921,37 @@ static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 		return 0;
 
 	/*
-	 * As an optimistic guess, use half of the mean service time
-	 * for this type of request. We can (and should) make this smarter.
-	 * For instance, if the completion latencies are tight, we can
-	 * get closer than just half the mean. This is especially
-	 * important on devices where the completion latencies are longer
-	 * than ~10 usec. We do use the stats for the relevant IO size
-	 * if available which does lead to better estimates.
+	 * Sleep for poll_hybrid_pct percent of the mean service time of this
+	 * type and size of request, as measured over the last stats window.
+	 * Never sleep past the fastest completion seen in that window though,
+	 * so that the busy poll still catches the quick ones and the tail
+	 * latency stays close to classic polling.
 	 */
 	bucket = blk_mq_poll_stats_bkt(rq);
 	if (bucket < 0)
-		return ret;
+		return 0;
 
-	if (q->poll_stat[bucket].nr_samples)
-		ret = (q->poll_stat[bucket].mean + 1) / 2;
+	stat = &q->poll_stat[bucket];
+	if (!stat->nr_samples)
+		return 0;
 
-	return ret;
+	nsecs = div_u64(stat->mean * READ_ONCE(q->poll_hybrid_pct), 100);
+	nsecs = min(nsecs, stat->min);
+
+	/*
+	 * The service time is measured from the issue, so take off the time
+	 * the request has been in flight already.
+	 */
+	if (rq->rq_flags & RQF_STATS) {
+		now = ktime_get_ns();
+		if (now > rq->io_start_time_ns) {
+			if (now - rq->io_start_time_ns >= nsecs)
+				return 0;
+			nsecs -= now - rq->io_start_time_ns;
+		}
+	}
+
+	return nsecs;
 }
 
 static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
@@ -4885,7 +4973,9 @@ static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
 	/*
 	 * If we get here, hybrid polling is enabled. Hence poll_nsec can be:
 	 *
-	 *  0:	use half of prev avg
+	 *  0:	use poll_hybrid_pct of the mean completion time of similar
+	 *	requests, minus the time this one has been in flight, see
+	 *	blk_mq_poll_nsecs()
 	 * >0:	use this specific value
 	 */
 	if (q->poll_nsec > 0)
@@ -4898,10 +4988,6 @@ static bool blk_mq_poll_hybrid(struct request_queue *q, blk_qc_t qc)
 
 	rq->rq_flags |= RQF_MQ_POLL_SLEPT;
 
-	/*
-	 * This will be replaced with the stats tracking code, using
-	 * 'avg_completion_time / 2' as the pre-sleep target.
-	 */
 	kt = nsecs;
 
 	mode = HRTIMER_MODE_REL;
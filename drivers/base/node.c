@@ -21,6 +21,7 @@
 #include <linux/swap.h>
 #include <linux/slab.h>
 #include <linux/hugetlb.h>
+#include <linux/memory-tiers.h>
 
 static struct bus_type node_subsys = {
 	.name = "node",
@@ -563,11 +564,33 @@ static ssize_t node_read_distance(struct device *dev,
 }
 static DEVICE_ATTR(distance, 0444, node_read_distance, NULL);
 
+#ifdef CONFIG_NUMA_BALANCING
+static ssize_t promote_rate_limit_MBps_show(struct device *dev,
+					    struct device_attribute *attr,
+					    char *buf)
+{
+	return sysfs_emit(buf, "%u\n", node_promote_rate_limit(dev->id));
+}
+static DEVICE_ATTR_RO(promote_rate_limit_MBps);
+
+static ssize_t promote_hot_threshold_ms_show(struct device *dev,
+					     struct device_attribute *attr,
+					     char *buf)
+{
+	return sysfs_emit(buf, "%u\n", node_promote_hot_threshold(dev->id));
+}
+static DEVICE_ATTR_RO(promote_hot_threshold_ms);
+#endif
+
 static struct attribute *node_dev_attrs[] = {
 	&dev_attr_meminfo.attr,
 	&dev_attr_numastat.attr,
 	&dev_attr_distance.attr,
 	&dev_attr_vmstat.attr,
+#ifdef CONFIG_NUMA_BALANCING
+	&dev_attr_promote_rate_limit_MBps.attr,
+	&dev_attr_promote_hot_threshold_ms.attr,
+#endif
 	NULL
 };
 
@@ -393,6 +393,7 @@ void nvme_complete_rq(struct request *req)
 	struct nvme_ctrl *ctrl = nvme_req(req)->ctrl;
 
 	trace_nvme_complete_rq(req);
+	nvme_mpath_end_request(req, true);
 	nvme_cleanup_cmd(req);
 
 	/*
@@ -432,6 +433,7 @@ EXPORT_SYMBOL_GPL(nvme_complete_rq);
 void nvme_complete_batch_req(struct request *req)
 {
 	trace_nvme_complete_rq(req);
+	nvme_mpath_end_request(req, true);
 	nvme_cleanup_cmd(req);
 	nvme_end_req_zoned(req);
 }
@@ -947,6 +949,9 @@ static inline blk_status_t nvme_setup_rw(struct nvme_ns *ns,
 
 void nvme_cleanup_cmd(struct request *req)
 {
+	/* no-op if the completion path already accounted for it */
+	nvme_mpath_end_request(req, false);
+
 	if (req->rq_flags & RQF_SPECIAL_PAYLOAD) {
 		struct nvme_ctrl *ctrl = nvme_req(req)->ctrl;
 
@@ -1009,6 +1014,8 @@ blk_status_t nvme_setup_cmd(struct nvme_ns *ns, struct request *req)
 
 	cmd->common.command_id = nvme_cid(req);
 	trace_nvme_setup_cmd(req, cmd);
+	if (ret == BLK_STS_OK)
+		nvme_mpath_start_request(req);
 	return ret;
 }
 EXPORT_SYMBOL_GPL(nvme_setup_cmd);
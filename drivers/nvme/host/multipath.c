@@ -17,6 +17,8 @@ MODULE_PARM_DESC(multipath,
 static const char *nvme_iopolicy_names[] = {
 	[NVME_IOPOLICY_NUMA]	= "numa",
 	[NVME_IOPOLICY_RR]	= "round-robin",
+	[NVME_IOPOLICY_QD]	= "queue-depth",
+	[NVME_IOPOLICY_ST]	= "service-time",
 };
 
 static int iopolicy = NVME_IOPOLICY_NUMA;
@@ -29,6 +31,10 @@ static int nvme_set_iopolicy(const char *val, const struct kernel_param *kp)
 		iopolicy = NVME_IOPOLICY_NUMA;
 	else if (!strncmp(val, "round-robin", 11))
 		iopolicy = NVME_IOPOLICY_RR;
+	else if (!strncmp(val, "queue-depth", 11))
+		iopolicy = NVME_IOPOLICY_QD;
+	else if (!strncmp(val, "service-time", 12))
+		iopolicy = NVME_IOPOLICY_ST;
 	else
 		return -EINVAL;
 
@@ -43,7 +49,8 @@ static int nvme_get_iopolicy(char *buf, const struct kernel_param *kp)
 module_param_call(iopolicy, nvme_set_iopolicy, nvme_get_iopolicy,
 	&iopolicy, 0644);
 MODULE_PARM_DESC(iopolicy,
-	"Default multipath I/O policy; 'numa' (default) or 'round-robin'");
+	"Default multipath I/O policy; 'numa' (default), 'round-robin', "
+	"'queue-depth' or 'service-time'");
 
 void nvme_mpath_default_iopolicy(struct nvme_subsystem *subsys)
 {
@@ -303,16 +310,122 @@ static inline bool nvme_path_is_optimized(struct nvme_ns *ns)
 		ns->ana_state == NVME_ANA_OPTIMIZED;
 }
 
+/*
+ * Weight of a new completion latency sample in the per-path moving average
+ * used by the service-time policy, as a shift: 1/8 of the sample is added.
+ */
+#define NVME_MPATH_EWMA_SHIFT	3
+
+static inline bool nvme_mpath_counts_active(struct nvme_subsystem *subsys)
+{
+	int policy = READ_ONCE(subsys->iopolicy);
+
+	return policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST;
+}
+
+void nvme_mpath_start_request(struct request *rq)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+
+	if (!(rq->cmd_flags & REQ_NVME_MPATH) ||
+	    (nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE) ||
+	    !nvme_mpath_counts_active(ns->head->subsys))
+		return;
+
+	nvme_req(rq)->flags |= NVME_MPATH_CNT_ACTIVE;
+	nvme_req(rq)->mpath_start = ktime_get_ns();
+	atomic_inc(&ns->nr_active);
+}
+EXPORT_SYMBOL_GPL(nvme_mpath_start_request);
+
+void nvme_mpath_end_request(struct request *rq, bool completed)
+{
+	struct nvme_ns *ns = rq->q->queuedata;
+	u64 sample, ewma;
+
+	if (!(nvme_req(rq)->flags & NVME_MPATH_CNT_ACTIVE))
+		return;
+
+	nvme_req(rq)->flags &= ~NVME_MPATH_CNT_ACTIVE;
+	atomic_dec(&ns->nr_active);
+
+	if (!completed || (nvme_req(rq)->flags & NVME_REQ_CANCELLED))
+		return;
+
+	/*
+	 * Racing updates from different completion queues may lose a sample,
+	 * which is harmless for a moving average used as a path weight.
+	 */
+	sample = ktime_get_ns() - nvme_req(rq)->mpath_start;
+	ewma = READ_ONCE(ns->latency_ewma);
+	if (ewma)
+		ewma = ewma - (ewma >> NVME_MPATH_EWMA_SHIFT) +
+			(sample >> NVME_MPATH_EWMA_SHIFT);
+	else
+		ewma = sample;
+	WRITE_ONCE(ns->latency_ewma, ewma);
+}
+EXPORT_SYMBOL_GPL(nvme_mpath_end_request);
+
+static u64 nvme_path_load(struct nvme_ns *ns, int policy)
+{
+	u64 depth = atomic_read(&ns->nr_active);
+
+	if (policy == NVME_IOPOLICY_QD)
+		return depth;
+	/* expected time for a new command to complete behind the queue */
+	return (depth + 1) * READ_ONCE(ns->latency_ewma);
+}
+
+static struct nvme_ns *nvme_least_loaded_path(struct nvme_ns_head *head,
+		int policy)
+{
+	u64 min_opt = U64_MAX, min_nonopt = U64_MAX;
+	struct nvme_ns *best_opt = NULL, *best_nonopt = NULL;
+	struct nvme_ns *ns;
+	u64 load;
+
+	list_for_each_entry_rcu(ns, &head->list, siblings) {
+		if (nvme_path_is_disabled(ns))
+			continue;
+
+		switch (ns->ana_state) {
+		case NVME_ANA_OPTIMIZED:
+			load = nvme_path_load(ns, policy);
+			if (load < min_opt) {
+				min_opt = load;
+				best_opt = ns;
+			}
+			break;
+		case NVME_ANA_NONOPTIMIZED:
+			load = nvme_path_load(ns, policy);
+			if (load < min_nonopt) {
+				min_nonopt = load;
+				best_nonopt = ns;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return best_opt ? best_opt : best_nonopt;
+}
+
 inline struct nvme_ns *nvme_find_path(struct nvme_ns_head *head)
 {
+	int policy = READ_ONCE(head->subsys->iopolicy);
 	int node = numa_node_id();
 	struct nvme_ns *ns;
 
+	if (policy == NVME_IOPOLICY_QD || policy == NVME_IOPOLICY_ST)
+		return nvme_least_loaded_path(head, policy);
+
 	ns = srcu_dereference(head->current_path[node], &head->srcu);
 	if (unlikely(!ns))
 		return __nvme_find_path(head, node);
 
-	if (READ_ONCE(head->subsys->iopolicy) == NVME_IOPOLICY_RR)
+	if (policy == NVME_IOPOLICY_RR)
 		return nvme_round_robin_path(head, node, ns);
 	if (unlikely(!nvme_path_is_optimized(ns)))
 		return __nvme_find_path(head, node);
@@ -172,6 +172,9 @@ struct nvme_request {
 	u8			retries;
 	u8			flags;
 	u16			status;
+#ifdef CONFIG_NVME_MULTIPATH
+	u64			mpath_start;
+#endif
 	struct nvme_ctrl	*ctrl;
 };
 
@@ -183,6 +186,7 @@ struct nvme_request {
 enum {
 	NVME_REQ_CANCELLED		= (1 << 0),
 	NVME_REQ_USERCMD		= (1 << 1),
+	NVME_MPATH_CNT_ACTIVE		= (1 << 2),
 };
 
 static inline struct nvme_request *nvme_req(struct request *req)
@@ -390,6 +394,8 @@ static inline enum nvme_ctrl_state nvme_ctrl_state(struct nvme_ctrl *ctrl)
 enum nvme_iopolicy {
 	NVME_IOPOLICY_NUMA,
 	NVME_IOPOLICY_RR,
+	NVME_IOPOLICY_QD,
+	NVME_IOPOLICY_ST,
 };
 
 struct nvme_subsystem {
@@ -481,6 +487,8 @@ struct nvme_ns {
 #ifdef CONFIG_NVME_MULTIPATH
 	enum nvme_ana_state ana_state;
 	u32 ana_grpid;
+	atomic_t nr_active;	/* in flight, for queue-depth/service-time */
+	u64 latency_ewma;	/* completion latency in ns, for service-time */
 #endif
 	struct list_head siblings;
 	struct kref kref;
@@ -902,6 +910,8 @@ bool nvme_mpath_clear_current_path(struct nvme_ns *ns);
 void nvme_mpath_revalidate_paths(struct nvme_ns *ns);
 void nvme_mpath_clear_ctrl_paths(struct nvme_ctrl *ctrl);
 void nvme_mpath_shutdown_disk(struct nvme_ns_head *head);
+void nvme_mpath_start_request(struct request *rq);
+void nvme_mpath_end_request(struct request *rq, bool completed);
 
 static inline void nvme_trace_bio_complete(struct request *req)
 {
@@ -955,6 +965,12 @@ static inline void nvme_mpath_shutdown_disk(struct nvme_ns_head *head)
 static inline void nvme_trace_bio_complete(struct request *req)
 {
 }
+static inline void nvme_mpath_start_request(struct request *rq)
+{
+}
+static inline void nvme_mpath_end_request(struct request *rq, bool completed)
+{
+}
 static inline void nvme_mpath_init_ctrl(struct nvme_ctrl *ctrl)
 {
 }
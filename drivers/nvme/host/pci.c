@@ -37,6 +37,9 @@
 
 #define SGES_PER_PAGE	(NVME_CTRL_PAGE_SIZE / sizeof(struct nvme_sgl_desc))
 
+/* Size of the PRP/SGL lists allocated from the small pool or the queue cache */
+#define NVME_SMALL_DESC_SIZE	256
+
 /*
  * These can be higher, but we need to ensure that any command doesn't
  * require an sg allocation that needs more than a page of data.
@@ -104,6 +107,11 @@ static bool noacpi;
 module_param(noacpi, bool, 0444);
 MODULE_PARM_DESC(noacpi, "disable acpi bios quirks");
 
+static bool io_desc_cache = true;
+module_param(io_desc_cache, bool, 0444);
+MODULE_PARM_DESC(io_desc_cache,
+	"preallocate a small PRP/SGL list per I/O queue entry");
+
 struct nvme_dev;
 struct nvme_queue;
 
@@ -214,6 +222,10 @@ struct nvme_queue {
 	__le32 *dbbuf_sq_ei;
 	__le32 *dbbuf_cq_ei;
 	struct completion delete_done;
+	/* per-tag small PRP/SGL lists, see nvme_pci_alloc_small_desc() */
+	void *descs;
+	dma_addr_t descs_dma;
+	u32 nr_descs;
 };
 
 /*
@@ -227,6 +239,7 @@ struct nvme_iod {
 	struct nvme_command cmd;
 	bool use_sgl;
 	bool aborted;
+	bool cached_desc;	/* small list is from the queue's cache */
 	s8 nr_allocations;	/* PRP list pool allocations. 0 means small
 				   pool in use */
 	unsigned int dma_len;	/* length of single DMA segment mapping */
@@ -528,6 +541,39 @@ static inline bool nvme_pci_use_sgls(struct nvme_dev *dev, struct request *req)
 	return true;
 }
 
+/*
+ * Most multi-page I/Os only need a PRP or SGL list that fits in the small
+ * pool.  Each I/O queue preallocates one such list per tag, so those don't
+ * need to go through the dma_pool and its lock.  The tag is owned by the
+ * request until it completes, so no other synchronization is needed.
+ */
+static void *nvme_pci_alloc_small_desc(struct nvme_dev *dev,
+		struct request *req, dma_addr_t *dma_addr)
+{
+	struct nvme_queue *nvmeq = req->mq_hctx->driver_data;
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+	size_t offset;
+
+	if (nvmeq->descs && req->tag < nvmeq->nr_descs) {
+		offset = (size_t)req->tag * NVME_SMALL_DESC_SIZE;
+		iod->cached_desc = true;
+		*dma_addr = nvmeq->descs_dma + offset;
+		return nvmeq->descs + offset;
+	}
+	return dma_pool_alloc(dev->prp_small_pool, GFP_ATOMIC, dma_addr);
+}
+
+static void nvme_pci_free_small_desc(struct nvme_dev *dev,
+		struct request *req)
+{
+	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
+
+	if (iod->cached_desc)
+		return;
+	dma_pool_free(dev->prp_small_pool, nvme_pci_iod_list(req)[0],
+		      iod->first_dma);
+}
+
 static void nvme_free_prps(struct nvme_dev *dev, struct request *req)
 {
 	const int last_prp = NVME_CTRL_PAGE_SIZE / sizeof(__le64) - 1;
@@ -575,8 +621,7 @@ static void nvme_unmap_data(struct nvme_dev *dev, struct request *req)
 	dma_unmap_sgtable(dev->dev, &iod->sgt, rq_dma_dir(req), 0);
 
 	if (iod->nr_allocations == 0)
-		dma_pool_free(dev->prp_small_pool, nvme_pci_iod_list(req)[0],
-			      iod->first_dma);
+		nvme_pci_free_small_desc(dev, req);
 	else if (iod->use_sgl)
 		nvme_free_sgls(dev, req);
 	else
@@ -602,7 +647,6 @@ static blk_status_t nvme_pci_setup_prps(struct nvme_dev *dev,
 		struct request *req, struct nvme_rw_command *cmnd)
 {
 	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
-	struct dma_pool *pool;
 	int length = blk_rq_payload_bytes(req);
 	struct scatterlist *sg = iod->sgt.sgl;
 	int dma_len = sg_dma_len(sg);
@@ -634,15 +678,14 @@ static blk_status_t nvme_pci_setup_prps(struct nvme_dev *dev,
 	}
 
 	nprps = DIV_ROUND_UP(length, NVME_CTRL_PAGE_SIZE);
-	if (nprps <= (256 / 8)) {
-		pool = dev->prp_small_pool;
+	if (nprps <= (NVME_SMALL_DESC_SIZE / 8)) {
 		iod->nr_allocations = 0;
+		prp_list = nvme_pci_alloc_small_desc(dev, req, &prp_dma);
 	} else {
-		pool = dev->prp_page_pool;
 		iod->nr_allocations = 1;
+		prp_list = dma_pool_alloc(dev->prp_page_pool, GFP_ATOMIC,
+					  &prp_dma);
 	}
-
-	prp_list = dma_pool_alloc(pool, GFP_ATOMIC, &prp_dma);
 	if (!prp_list) {
 		iod->nr_allocations = -1;
 		return BLK_STS_RESOURCE;
@@ -653,7 +696,8 @@ static blk_status_t nvme_pci_setup_prps(struct nvme_dev *dev,
 	for (;;) {
 		if (i == NVME_CTRL_PAGE_SIZE >> 3) {
 			__le64 *old_prp_list = prp_list;
-			prp_list = dma_pool_alloc(pool, GFP_ATOMIC, &prp_dma);
+			prp_list = dma_pool_alloc(dev->prp_page_pool,
+						  GFP_ATOMIC, &prp_dma);
 			if (!prp_list)
 				goto free_prps;
 			list[iod->nr_allocations++] = prp_list;
@@ -714,7 +758,6 @@ static blk_status_t nvme_pci_setup_sgls(struct nvme_dev *dev,
 		struct request *req, struct nvme_rw_command *cmd)
 {
 	struct nvme_iod *iod = blk_mq_rq_to_pdu(req);
-	struct dma_pool *pool;
 	struct nvme_sgl_desc *sg_list;
 	struct scatterlist *sg = iod->sgt.sgl;
 	unsigned int entries = iod->sgt.nents;
@@ -729,15 +772,14 @@ static blk_status_t nvme_pci_setup_sgls(struct nvme_dev *dev,
 		return BLK_STS_OK;
 	}
 
-	if (entries <= (256 / sizeof(struct nvme_sgl_desc))) {
-		pool = dev->prp_small_pool;
+	if (entries <= (NVME_SMALL_DESC_SIZE / sizeof(struct nvme_sgl_desc))) {
 		iod->nr_allocations = 0;
+		sg_list = nvme_pci_alloc_small_desc(dev, req, &sgl_dma);
 	} else {
-		pool = dev->prp_page_pool;
 		iod->nr_allocations = 1;
+		sg_list = dma_pool_alloc(dev->prp_page_pool, GFP_ATOMIC,
+					 &sgl_dma);
 	}
-
-	sg_list = dma_pool_alloc(pool, GFP_ATOMIC, &sgl_dma);
 	if (!sg_list) {
 		iod->nr_allocations = -1;
 		return BLK_STS_RESOURCE;
@@ -753,7 +795,8 @@ static blk_status_t nvme_pci_setup_sgls(struct nvme_dev *dev,
 			struct nvme_sgl_desc *old_sg_desc = sg_list;
 			struct nvme_sgl_desc *link = &old_sg_desc[i - 1];
 
-			sg_list = dma_pool_alloc(pool, GFP_ATOMIC, &sgl_dma);
+			sg_list = dma_pool_alloc(dev->prp_page_pool,
+						 GFP_ATOMIC, &sgl_dma);
 			if (!sg_list)
 				goto free_sgls;
 
@@ -887,6 +930,7 @@ static blk_status_t nvme_prep_rq(struct nvme_dev *dev, struct request *req)
 	blk_status_t ret;
 
 	iod->aborted = false;
+	iod->cached_desc = false;
 	iod->nr_allocations = -1;
 	iod->sgt.nents = 0;
 
@@ -1442,6 +1486,12 @@ static enum blk_eh_timer_return nvme_timeout(struct request *req)
 
 static void nvme_free_queue(struct nvme_queue *nvmeq)
 {
+	if (nvmeq->descs) {
+		dma_free_coherent(nvmeq->dev->dev,
+				  (size_t)nvmeq->nr_descs * NVME_SMALL_DESC_SIZE,
+				  nvmeq->descs, nvmeq->descs_dma);
+		nvmeq->descs = NULL;
+	}
 	dma_free_coherent(nvmeq->dev->dev, CQ_SIZE(nvmeq),
 				(void *)nvmeq->cqes, nvmeq->cq_dma_addr);
 	if (!nvmeq->sq_cmds)
@@ -1591,6 +1641,15 @@ static int nvme_alloc_queue(struct nvme_dev *dev, int qid, int depth)
 	if (nvme_alloc_sq_cmds(dev, nvmeq, qid))
 		goto free_cqdma;
 
+	/* Optional, requests fall back to the small pool without it */
+	if (qid && io_desc_cache) {
+		nvmeq->descs = dma_alloc_coherent(dev->dev,
+				(size_t)depth * NVME_SMALL_DESC_SIZE,
+				&nvmeq->descs_dma, GFP_KERNEL | __GFP_NOWARN);
+		if (nvmeq->descs)
+			nvmeq->nr_descs = depth;
+	}
+
 	nvmeq->dev = dev;
 	spin_lock_init(&nvmeq->sq_lock);
 	spin_lock_init(&nvmeq->cq_poll_lock);
@@ -2753,7 +2812,8 @@ static int nvme_setup_prp_pools(struct nvme_dev *dev)
 
 	/* Optimisation for I/Os between 4k and 128k */
 	dev->prp_small_pool = dma_pool_create("prp list 256", dev->dev,
-						256, 256, 0);
+						NVME_SMALL_DESC_SIZE,
+						NVME_SMALL_DESC_SIZE, 0);
 	if (!dev->prp_small_pool) {
 		dma_pool_destroy(dev->prp_page_pool);
 		return -ENOMEM;
@@ -20,6 +20,9 @@
 
 struct nvme_tcp_queue;
 
+/* Max PDU parts sent by io_work per socket lock hold */
+#define NVME_TCP_SEND_BUDGET	16
+
 /* Define the socket priority to use for connections were it is desirable
  * that the NIC consider performing optimized packet processing or filtering.
  * A non-zero value being sufficient to indicate general consideration of any
@@ -307,12 +310,15 @@ static inline void nvme_tcp_advance_req(struct nvme_tcp_request *req,
 
 static inline void nvme_tcp_send_all(struct nvme_tcp_queue *queue)
 {
+	struct sock *sk = queue->sock->sk;
 	int ret;
 
 	/* drain the send queue as much as we can... */
+	lock_sock(sk);
 	do {
 		ret = nvme_tcp_try_send(queue);
 	} while (ret > 0);
+	release_sock(sk);
 }
 
 static inline bool nvme_tcp_queue_more(struct nvme_tcp_queue *queue)
@@ -992,11 +998,11 @@ static int nvme_tcp_try_send_data(struct nvme_tcp_request *req)
 			flags |= MSG_MORE | MSG_SENDPAGE_NOTLAST;
 
 		if (sendpage_ok(page)) {
-			ret = kernel_sendpage(queue->sock, page, offset, len,
-					flags);
+			ret = kernel_sendpage_locked(queue->sock->sk, page,
+					offset, len, flags);
 		} else {
-			ret = sock_no_sendpage(queue->sock, page, offset, len,
-					flags);
+			ret = sock_no_sendpage_locked(queue->sock->sk, page,
+					offset, len, flags);
 		}
 		if (ret <= 0)
 			return ret;
@@ -1050,7 +1056,7 @@ static int nvme_tcp_try_send_cmd_pdu(struct nvme_tcp_request *req)
 	if (queue->hdr_digest && !req->offset)
 		nvme_tcp_hdgst(queue->snd_hash, pdu, sizeof(*pdu));
 
-	ret = kernel_sendpage(queue->sock, virt_to_page(pdu),
+	ret = kernel_sendpage_locked(queue->sock->sk, virt_to_page(pdu),
 			offset_in_page(pdu) + req->offset, len,  flags);
 	if (unlikely(ret <= 0))
 		return ret;
@@ -1083,11 +1089,12 @@ static int nvme_tcp_try_send_data_pdu(struct nvme_tcp_request *req)
 		nvme_tcp_hdgst(queue->snd_hash, pdu, sizeof(*pdu));
 
 	if (!req->h2cdata_left)
-		ret = kernel_sendpage(queue->sock, virt_to_page(pdu),
+		ret = kernel_sendpage_locked(queue->sock->sk, virt_to_page(pdu),
 				offset_in_page(pdu) + req->offset, len,
 				MSG_DONTWAIT | MSG_MORE | MSG_SENDPAGE_NOTLAST);
 	else
-		ret = sock_no_sendpage(queue->sock, virt_to_page(pdu),
+		ret = sock_no_sendpage_locked(queue->sock->sk,
+				virt_to_page(pdu),
 				offset_in_page(pdu) + req->offset, len,
 				MSG_DONTWAIT | MSG_MORE);
 	if (unlikely(ret <= 0))
@@ -1122,7 +1129,8 @@ static int nvme_tcp_try_send_ddgst(struct nvme_tcp_request *req)
 	else
 		msg.msg_flags |= MSG_EOR;
 
-	ret = kernel_sendmsg(queue->sock, &msg, &iov, 1, iov.iov_len);
+	ret = kernel_sendmsg_locked(queue->sock->sk, &msg, &iov, 1,
+			iov.iov_len);
 	if (unlikely(ret <= 0))
 		return ret;
 
@@ -1138,6 +1146,12 @@ static int nvme_tcp_try_send_ddgst(struct nvme_tcp_request *req)
 	return -EAGAIN;
 }
 
+/*
+ * Must be called with the send_mutex and the socket lock held.  Sending
+ * with the socket lock held across PDUs and requests lets MSG_MORE coalesce
+ * them into full sized segments, and the frames are pushed out at the
+ * release_sock() at the latest.
+ */
 static int nvme_tcp_try_send(struct nvme_tcp_queue *queue)
 {
 	struct nvme_tcp_request *req;
@@ -1204,6 +1218,27 @@ static int nvme_tcp_try_recv(struct nvme_tcp_queue *queue)
 	return consumed;
 }
 
+/*
+ * Send up to @budget PDU parts with a single socket lock hold, rather than
+ * locking the socket for every page.  The budget bounds the time incoming
+ * segments are left in the socket backlog.
+ */
+static int nvme_tcp_try_send_batch(struct nvme_tcp_queue *queue, int budget)
+{
+	struct sock *sk = queue->sock->sk;
+	int ret, sent = 0;
+
+	lock_sock(sk);
+	do {
+		ret = nvme_tcp_try_send(queue);
+	} while (ret > 0 && ++sent < budget);
+	release_sock(sk);
+
+	if (ret < 0)
+		return ret;
+	return sent ? 1 : ret;
+}
+
 static void nvme_tcp_io_work(struct work_struct *w)
 {
 	struct nvme_tcp_queue *queue =
@@ -1215,7 +1250,8 @@ static void nvme_tcp_io_work(struct work_struct *w)
 		int result;
 
 		if (mutex_trylock(&queue->send_mutex)) {
-			result = nvme_tcp_try_send(queue);
+			result = nvme_tcp_try_send_batch(queue,
+					NVME_TCP_SEND_BUDGET);
 			mutex_unlock(&queue->send_mutex);
 			if (result > 0)
 				pending = true;
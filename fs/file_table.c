@@ -410,7 +410,8 @@ EXPORT_SYMBOL(__fput_sync);
 void __init files_init(void)
 {
 	filp_cachep = kmem_cache_create("filp", sizeof(struct file), 0,
-			SLAB_HWCACHE_ALIGN | SLAB_PANIC | SLAB_ACCOUNT, NULL);
+			SLAB_HWCACHE_ALIGN | SLAB_PANIC | SLAB_ACCOUNT |
+			SLAB_PERCPU_SHEAVES, NULL);
 	percpu_counter_init(&nr_files, 0, GFP_KERNEL);
 }
 
@@ -38,6 +38,20 @@ enum wb_stat_item {
 
 #define WB_STAT_BATCH (8*(1+ilog2(nr_cpu_ids)))
 
+/*
+ * Readahead statistics, reported in /sys/class/bdi/<bdi>/readahead_stat
+ */
+enum bdi_ra_stat_item {
+	BDI_RA_MISS,		/* readahead started by a page cache miss */
+	BDI_RA_HIT,		/* readahead started by hitting the marker */
+	BDI_RA_PAGES,		/* pages submitted for readahead */
+	BDI_RA_WASTE,		/* markers evicted before being reached */
+	BDI_RA_STRIDE,		/* forward strided windows */
+	BDI_RA_REVERSE,		/* backward windows */
+	BDI_RA_INTERLEAVED,	/* marker hits outside the current window */
+	NR_BDI_RA_STAT_ITEMS
+};
+
 /*
  * why some writeback work was initiated
  */
@@ -180,6 +194,8 @@ struct backing_dev_info {
 	 */
 	atomic_long_t tot_write_bandwidth;
 
+	atomic_long_t ra_stat[NR_BDI_RA_STAT_ITEMS];
+
 	struct bdi_writeback wb;  /* the root writeback info for this bdi */
 	struct list_head wb_list; /* list of all wbs */
 #ifdef CONFIG_CGROUP_WRITEBACK
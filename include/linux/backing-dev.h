@@ -90,6 +90,18 @@ static inline s64 wb_stat_sum(struct bdi_writeback *wb, enum wb_stat_item item)
 
 extern void wb_writeout_inc(struct bdi_writeback *wb);
 
+static inline void bdi_ra_stat_add(struct backing_dev_info *bdi,
+				   enum bdi_ra_stat_item item, long nr)
+{
+	atomic_long_add(nr, &bdi->ra_stat[item]);
+}
+
+static inline void bdi_ra_stat_inc(struct backing_dev_info *bdi,
+				   enum bdi_ra_stat_item item)
+{
+	bdi_ra_stat_add(bdi, item, 1);
+}
+
 /*
  * maximal error of a stat counter.
  */
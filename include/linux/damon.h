@@ -351,6 +351,54 @@ struct damon_operations {
 	void (*cleanup)(struct damon_ctx *context);
 };
 
+/**
+ * struct damon_sampler - Access sampling backend for an operations set.
+ *
+ * @name:			Name of this sampler.
+ * @ops_id:			Identifier of the operations set this works with.
+ * @prepare_access_checks:	Prepare next access check of target regions.
+ * @check_accesses:		Check the accesses to target regions.
+ * @reset_aggregated:		Reset sampler state at each aggregation.
+ * @list:			List head for the registered samplers.
+ *
+ * A sampler replaces the access sampling part of the &struct damon_operations
+ * of id @ops_id, so that the way the accessed state is collected (e.g., rmap
+ * walks, batched page table scans, or hardware-provided access samples) can be
+ * chosen independently of the address space.  @prepare_access_checks and
+ * @check_accesses have the same semantics as those of &struct
+ * damon_operations, and are called instead of those if the sampler is
+ * selected.  @reset_aggregated is optional and called after each
+ * &damon_attrs.aggr_interval, in addition to &damon_operations.reset_aggregated.
+ *
+ * Samplers are registered via damon_register_sampler() and selected by
+ * damon_select_sampler().
+ */
+struct damon_sampler {
+	const char *name;
+	enum damon_ops_id ops_id;
+	void (*prepare_access_checks)(struct damon_ctx *context);
+	unsigned int (*check_accesses)(struct damon_ctx *context);
+	void (*reset_aggregated)(struct damon_ctx *context);
+	struct list_head list;
+};
+
+/**
+ * struct damon_sampling_stat - Access sampling overhead statistics.
+ *
+ * @nr_samples:		Number of region samples that checked.
+ * @nr_walks:		Number of reverse mapping or page table walks made.
+ * @sampling_ns:	Time spent for preparing and checking the accesses.
+ *
+ * Updated by the monitoring thread only, and reset when it starts.
+ * @nr_samples and @nr_walks are maintained by the operations set or the
+ * sampler, if it supports those.
+ */
+struct damon_sampling_stat {
+	unsigned long nr_samples;
+	unsigned long nr_walks;
+	u64 sampling_ns;
+};
+
 /**
  * struct damon_callback - Monitoring events notification callbacks.
  *
@@ -442,8 +490,11 @@ struct damon_attrs {
  * Accesses to other fields must be protected by themselves.
  *
  * @ops:	Set of monitoring operations for given use cases.
+ * @sampler:	Access sampling backend to use instead of @ops, if not NULL.
  * @callback:	Set of callbacks for monitoring events notifications.
  *
+ * @sampling_stat:	Overhead of the access sampling.
+ *
  * @adaptive_targets:	Head of monitoring targets (&damon_target) list.
  * @schemes:		Head of schemes (&damos) list.
  */
@@ -461,8 +512,11 @@ struct damon_ctx {
 	struct mutex kdamond_lock;
 
 	struct damon_operations ops;
+	struct damon_sampler *sampler;
 	struct damon_callback callback;
 
+	struct damon_sampling_stat sampling_stat;
+
 	struct list_head adaptive_targets;
 	struct list_head schemes;
 };
@@ -556,6 +610,8 @@ int damon_nr_running_ctxs(void);
 bool damon_is_registered_ops(enum damon_ops_id id);
 int damon_register_ops(struct damon_operations *ops);
 int damon_select_ops(struct damon_ctx *ctx, enum damon_ops_id id);
+int damon_register_sampler(struct damon_sampler *sampler);
+int damon_select_sampler(struct damon_ctx *ctx, const char *name);
 
 static inline bool damon_target_has_pid(const struct damon_ctx *ctx)
 {
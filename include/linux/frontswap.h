@@ -10,7 +10,11 @@
 struct frontswap_ops {
 	void (*init)(unsigned); /* this swap type was just swapon'ed */
 	int (*store)(unsigned, pgoff_t, struct page *); /* store a page */
+	/* store nr contiguous pages, all or nothing (optional) */
+	int (*store_batch)(unsigned, pgoff_t, struct page *, unsigned int);
 	int (*load)(unsigned, pgoff_t, struct page *); /* load a page */
+	/* load nr contiguous pages, fails if any is missing (optional) */
+	int (*load_batch)(unsigned, pgoff_t, struct page *, unsigned int);
 	void (*invalidate_page)(unsigned, pgoff_t); /* page no longer needed */
 	void (*invalidate_area)(unsigned); /* swap type just swapoff'ed */
 };
@@ -22,6 +26,7 @@ extern int __frontswap_store(struct page *page);
 extern int __frontswap_load(struct page *page);
 extern void __frontswap_invalidate_page(unsigned, pgoff_t);
 extern void __frontswap_invalidate_area(unsigned);
+extern bool __frontswap_test_uniform(unsigned, pgoff_t, unsigned int);
 
 #ifdef CONFIG_FRONTSWAP
 extern struct static_key_false frontswap_enabled_key;
@@ -76,6 +81,22 @@ static inline int frontswap_load(struct page *page)
 	return -1;
 }
 
+/*
+ * Whether frontswap holds either all or none of the nr entries starting
+ * at offset, so that they can be read back as one large folio.  This only
+ * looks at the bitmap: an entry the backend has since written back still
+ * counts as held, and frontswap_load() then fails the whole folio with
+ * -EAGAIN.
+ */
+static inline bool frontswap_test_uniform(unsigned type, pgoff_t offset,
+					  unsigned int nr)
+{
+	if (frontswap_enabled())
+		return __frontswap_test_uniform(type, offset, nr);
+
+	return true;
+}
+
 static inline void frontswap_invalidate_page(unsigned type, pgoff_t offset)
 {
 	if (frontswap_enabled())
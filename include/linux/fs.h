@@ -919,6 +919,10 @@ struct fown_struct {
  * @ra_pages: Maximum size of a readahead request, copied from the bdi.
  * @mmap_miss: How many mmap accesses missed in the page cache.
  * @prev_pos: The last byte in the most recent read request.
+ * @prev_miss: Index of the most recent non-sequential cache miss.
+ * @stride: Distance in pages between the last two non-sequential misses;
+ *      negative for reads going backwards through the file.
+ * @stride_hits: How many misses in a row were @stride apart.
  *
  * When this structure is passed to ->readahead(), the "most recent"
  * readahead means the current readahead.
@@ -930,6 +934,9 @@ struct file_ra_state {
 	unsigned int ra_pages;
 	unsigned int mmap_miss;
 	loff_t prev_pos;
+	pgoff_t prev_miss;
+	int stride;
+	unsigned int stride_hits;
 };
 
 /*
@@ -608,6 +608,10 @@ generic_hugetlb_get_unmapped_area(struct file *file, unsigned long addr,
  * HPG_vmemmap_optimized - Set when the vmemmap pages of the page are freed.
  * HPG_raw_hwp_unreliable - Set when the hugetlb page has a hwpoison sub-page
  *     that is not tracked by raw_hwp_page list.
+ * HPG_zeroed - Set when a free page was cleared in advance, so that the
+ *	first user does not need to clear it.  Cleared when the page is freed.
+ *	Synchronization: hugetlb_lock held for modification while the page is
+ *	on the free lists.
  */
 enum hugetlb_page_flags {
 	HPG_restore_reserve = 0,
@@ -616,6 +620,7 @@ enum hugetlb_page_flags {
 	HPG_freed,
 	HPG_vmemmap_optimized,
 	HPG_raw_hwp_unreliable,
+	HPG_zeroed,
 	__NR_HPAGEFLAGS,
 };
 
@@ -687,6 +692,7 @@ HPAGEFLAG(Temporary, temporary)
 HPAGEFLAG(Freed, freed)
 HPAGEFLAG(VmemmapOptimized, vmemmap_optimized)
 HPAGEFLAG(RawHwpUnreliable, raw_hwp_unreliable)
+HPAGEFLAG(Zeroed, zeroed)
 
 #ifdef CONFIG_HUGETLB_PAGE
 
@@ -711,6 +717,11 @@ struct hstate {
 	unsigned int nr_huge_pages_node[MAX_NUMNODES];
 	unsigned int free_huge_pages_node[MAX_NUMNODES];
 	unsigned int surplus_huge_pages_node[MAX_NUMNODES];
+	unsigned long zeroed_huge_pages;
+	unsigned int zeroed_huge_pages_node[MAX_NUMNODES];
+	unsigned long zeroing_huge_pages;
+	unsigned int zeroing_huge_pages_node[MAX_NUMNODES];
+	unsigned int prezero_huge_pages_node[MAX_NUMNODES];
 #ifdef CONFIG_CGROUP_HUGETLB
 	/* cgroup control files */
 	struct cftype cgroup_files_dfl[8];
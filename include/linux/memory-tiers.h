@@ -99,4 +99,9 @@ static inline bool node_is_toptier(int node)
 	return true;
 }
 #endif	/* CONFIG_NUMA */
+
+#ifdef CONFIG_NUMA_BALANCING
+unsigned int node_promote_rate_limit(int node);
+unsigned int node_promote_hot_threshold(int node);
+#endif
 #endif  /* _LINUX_MEMORY_TIERS_H */
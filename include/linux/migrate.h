@@ -18,6 +18,8 @@ struct migration_target_control;
  * - zero on page migration success;
  */
 #define MIGRATEPAGE_SUCCESS		0
+/* Internal to migrate_pages(): folio unmapped, waiting to be moved */
+#define MIGRATEPAGE_UNMAP		1
 
 /**
  * struct movable_operations - Driver page migration
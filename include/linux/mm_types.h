@@ -512,6 +512,7 @@ struct vm_area_struct {
 
 #ifdef CONFIG_SWAP
 	atomic_long_t swap_readahead_info;
+	atomic_long_t swap_ra_stride;	/* swap-in stride and confidence */
 #endif
 #ifndef CONFIG_MMU
 	struct vm_region *vm_region;	/* NOMMU mapping region */
@@ -211,6 +211,9 @@ enum node_stat_item {
 	PGPROMOTE_SUCCESS,	/* promote successfully */
 	PGPROMOTE_CANDIDATE,	/* candidate pages to promote */
 #endif
+	/* PGDEMOTE_*: pages demoted from this node */
+	PGDEMOTE_KSWAPD,
+	PGDEMOTE_DIRECT,
 	NR_VM_NODE_STAT_ITEMS
 };
 
@@ -674,10 +677,14 @@ struct per_cpu_pages {
 	int count;		/* number of pages in the list */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
+	int high_min;		/* lowest high in adaptive mode */
+	int high_max;		/* highest high in adaptive mode */
 	short free_factor;	/* batch scaling factor during free */
+	short alloc_factor;	/* batch scaling factor during allocate */
 #ifdef CONFIG_NUMA
 	short expire;		/* When 0, remote pagesets are drained */
 #endif
+	unsigned long buddy_batches;	/* zone->lock round trips */
 
 	/* Lists of pages, one per migrate type stored on the pcp-lists */
 	struct list_head lists[NR_PCP_LISTS];
@@ -831,6 +838,7 @@ struct zone {
 	 * faster access
 	 */
 	int pageset_high;
+	int pageset_high_max;
 	int pageset_batch;
 
 #ifndef CONFIG_SPARSEMEM
@@ -1482,6 +1490,8 @@ int lowmem_reserve_ratio_sysctl_handler(struct ctl_table *, int, void *,
 		size_t *, loff_t *);
 int percpu_pagelist_high_fraction_sysctl_handler(struct ctl_table *, int,
 		void *, size_t *, loff_t *);
+int percpu_pagelist_adaptive_sysctl_handler(struct ctl_table *, int,
+		void *, size_t *, loff_t *);
 int sysctl_min_unmapped_ratio_sysctl_handler(struct ctl_table *, int,
 		void *, size_t *, loff_t *);
 int sysctl_min_slab_ratio_sysctl_handler(struct ctl_table *, int,
@@ -1489,6 +1499,7 @@ int sysctl_min_slab_ratio_sysctl_handler(struct ctl_table *, int,
 int numa_zonelist_order_handler(struct ctl_table *, int,
 		void *, size_t *, loff_t *);
 extern int percpu_pagelist_high_fraction;
+extern int percpu_pagelist_adaptive;
 extern char numa_zonelist_order[];
 #define NUMA_ZONELIST_ORDER_LEN	16
 
@@ -96,6 +96,13 @@
 /* Avoid kmemleak tracing */
 #define SLAB_NOLEAKTRACE	((slab_flags_t __force)0x00800000U)
 
+/* Cache objects in per cpu arrays in front of the slabs */
+#ifdef CONFIG_SLUB
+# define SLAB_PERCPU_SHEAVES	((slab_flags_t __force)0x01000000U)
+#else
+# define SLAB_PERCPU_SHEAVES	0
+#endif
+
 /* Fault injection mark */
 #ifdef CONFIG_FAILSLAB
 # define SLAB_FAILSLAB		((slab_flags_t __force)0x02000000U)
@@ -39,6 +39,10 @@ enum stat_item {
 	CPU_PARTIAL_FREE,	/* Refill cpu partial on free */
 	CPU_PARTIAL_NODE,	/* Refill cpu partial from node partial */
 	CPU_PARTIAL_DRAIN,	/* Drain cpu partial to node partial */
+	SHEAF_ALLOC,		/* Allocation from cpu sheaf */
+	SHEAF_FREE,		/* Free to cpu sheaf */
+	SHEAF_REFILL,		/* Refill empty cpu sheaf from slabs */
+	SHEAF_FLUSH,		/* Return objects from cpu sheaf to slabs */
 	NR_SLUB_STAT_ITEMS };
 
 /*
@@ -75,6 +79,17 @@ struct kmem_cache_cpu {
 #define slub_percpu_partial_read_once(c)	NULL
 #endif // CONFIG_SLUB_CPU_PARTIAL
 
+/*
+ * Per cpu array of free objects kept in front of the cpu slab for caches
+ * created with SLAB_PERCPU_SHEAVES. Objects are allocated and freed in
+ * LIFO order and are exchanged with the slabs in batches.
+ */
+struct slub_percpu_sheaf {
+	local_lock_t lock;	/* Protects the fields below */
+	unsigned int size;	/* Number of objects in the sheaf */
+	void *objects[];
+};
+
 /*
  * Word size structure that can be atomically updated or read and that
  * contains both the order and the number of objects that a slab of the
@@ -102,6 +117,9 @@ struct kmem_cache {
 	/* Number of per cpu partial slabs to keep around */
 	unsigned int cpu_partial_slabs;
 #endif
+	/* Per cpu object arrays, NULL unless SLAB_PERCPU_SHEAVES */
+	struct slub_percpu_sheaf __percpu *cpu_sheaves;
+	unsigned int sheaf_capacity;
 	struct kmem_cache_order_objects oo;
 
 	/* Allocation and freeing of slabs */
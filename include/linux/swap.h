@@ -342,6 +342,7 @@ struct vma_swap_readahead {
 	unsigned short win;
 	unsigned short offset;
 	unsigned short nr_pte;
+	long stride;		/* in pages, 0 unless a stride is predicted */
 #ifdef CONFIG_64BIT
 	pte_t *ptes;
 #else
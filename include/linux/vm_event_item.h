@@ -40,8 +40,6 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		PGREUSE,
 		PGSTEAL_KSWAPD,
 		PGSTEAL_DIRECT,
-		PGDEMOTE_KSWAPD,
-		PGDEMOTE_DIRECT,
 		PGSCAN_KSWAPD,
 		PGSCAN_DIRECT,
 		PGSCAN_DIRECT_THROTTLE,
@@ -69,6 +67,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_MIGRATION_SUCCESS,
 		THP_MIGRATION_FAIL,
 		THP_MIGRATION_SPLIT,
+		PGMIGRATE_COPY_BYTES,
+		PGMIGRATE_COPY_PARALLEL,
 #endif
 #ifdef CONFIG_COMPACTION
 		COMPACTMIGRATE_SCANNED, COMPACTFREE_SCANNED,
@@ -101,6 +101,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_FILE_FALLBACK,
 		THP_FILE_FALLBACK_CHARGE,
 		THP_FILE_MAPPED,
+		SHMEM_MTHP_ALLOC,
+		SHMEM_MTHP_FALLBACK,
 		THP_SPLIT_PAGE,
 		THP_SPLIT_PAGE_FAILED,
 		THP_DEFERRED_SPLIT_PAGE,
@@ -115,6 +117,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 		THP_ZERO_PAGE_ALLOC_FAILED,
 		THP_SWPOUT,
 		THP_SWPOUT_FALLBACK,
+		THP_SWPIN,
+		THP_SWPIN_FALLBACK,
 #endif
 #ifdef CONFIG_MEMORY_BALLOON
 		BALLOON_INFLATE,
@@ -132,6 +136,9 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #ifdef CONFIG_SWAP
 		SWAP_RA,
 		SWAP_RA_HIT,
+		SWAP_RA_STRIDE,
+		SWAP_RA_STRIDE_HIT,
+		SWAP_RA_STRIDE_MISS,
 #ifdef CONFIG_KSM
 		KSM_SWPIN_COPY,
 #endif
@@ -155,6 +162,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PSWPIN, PSWPOUT,
 #define THP_FILE_FALLBACK ({ BUILD_BUG(); 0; })
 #define THP_FILE_FALLBACK_CHARGE ({ BUILD_BUG(); 0; })
 #define THP_FILE_MAPPED ({ BUILD_BUG(); 0; })
+#define SHMEM_MTHP_ALLOC ({ BUILD_BUG(); 0; })
+#define SHMEM_MTHP_FALLBACK ({ BUILD_BUG(); 0; })
 #endif
 
 #endif		/* VM_EVENT_ITEM_H_INCLUDED */
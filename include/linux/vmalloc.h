@@ -69,7 +69,8 @@ struct vmap_area {
 	/*
 	 * The following two variables can be packed, because
 	 * a vmap_area object can be either:
-	 *    1) in "free" tree (root is free_vmap_area_root)
+	 *    1) in "free" tree (root is free_vmap_area_root or
+	 *       a vmap zone's free_root)
 	 *    2) or "busy" tree (root is vmap_area_root)
 	 */
 	union {
@@ -36,6 +36,10 @@ enum zs_mapmode {
 struct zs_pool_stats {
 	/* How many pages were migrated (freed) */
 	atomic_long_t pages_compacted;
+	/* How many of those were freed by background compaction */
+	atomic_long_t bg_pages_compacted;
+	/* How many background compaction runs completed */
+	atomic_long_t bg_compactions;
 };
 
 struct zs_pool;
@@ -54,6 +58,8 @@ void zs_unmap_object(struct zs_pool *pool, unsigned long handle);
 
 unsigned long zs_get_total_pages(struct zs_pool *pool);
 unsigned long zs_compact(struct zs_pool *pool);
+int zs_set_compact_threshold(struct zs_pool *pool, size_t size,
+			     unsigned int percent);
 
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats);
 #endif
@@ -2272,6 +2272,15 @@ static struct ctl_table vm_table[] = {
 		.proc_handler	= percpu_pagelist_high_fraction_sysctl_handler,
 		.extra1		= SYSCTL_ZERO,
 	},
+	{
+		.procname	= "percpu_pagelist_adaptive",
+		.data		= &percpu_pagelist_adaptive,
+		.maxlen		= sizeof(percpu_pagelist_adaptive),
+		.mode		= 0644,
+		.proc_handler	= percpu_pagelist_adaptive_sysctl_handler,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= SYSCTL_ONE,
+	},
 	{
 		.procname	= "page_lock_unfairness",
 		.data		= &sysctl_page_lock_unfairness,
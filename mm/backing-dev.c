@@ -209,11 +209,35 @@ static ssize_t stable_pages_required_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(stable_pages_required);
 
+static const char * const bdi_ra_stat_text[NR_BDI_RA_STAT_ITEMS] = {
+	[BDI_RA_MISS]		= "miss",
+	[BDI_RA_HIT]		= "hit",
+	[BDI_RA_PAGES]		= "pages",
+	[BDI_RA_WASTE]		= "waste",
+	[BDI_RA_STRIDE]		= "stride",
+	[BDI_RA_REVERSE]	= "reverse",
+	[BDI_RA_INTERLEAVED]	= "interleaved",
+};
+
+static ssize_t readahead_stat_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	struct backing_dev_info *bdi = dev_get_drvdata(dev);
+	int i, len = 0;
+
+	for (i = 0; i < NR_BDI_RA_STAT_ITEMS; i++)
+		len += sysfs_emit_at(buf, len, "%s %lu\n", bdi_ra_stat_text[i],
+				     atomic_long_read(&bdi->ra_stat[i]));
+	return len;
+}
+static DEVICE_ATTR_RO(readahead_stat);
+
 static struct attribute *bdi_dev_attrs[] = {
 	&dev_attr_read_ahead_kb.attr,
 	&dev_attr_min_ratio.attr,
 	&dev_attr_max_ratio.attr,
 	&dev_attr_stable_pages_required.attr,
+	&dev_attr_readahead_stat.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(bdi_dev);
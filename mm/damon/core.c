@@ -28,6 +28,7 @@ static bool running_exclusive_ctxs;
 
 static DEFINE_MUTEX(damon_ops_lock);
 static struct damon_operations damon_registered_ops[NR_DAMON_OPS];
+static LIST_HEAD(damon_registered_samplers);
 
 static struct kmem_cache *damon_region_cache __ro_after_init;
 
@@ -104,10 +105,82 @@ int damon_select_ops(struct damon_ctx *ctx, enum damon_ops_id id)
 		return -EINVAL;
 
 	mutex_lock(&damon_ops_lock);
-	if (!__damon_is_registered_ops(id))
+	if (!__damon_is_registered_ops(id)) {
 		err = -EINVAL;
-	else
+	} else {
 		ctx->ops = damon_registered_ops[id];
+		if (ctx->sampler && ctx->sampler->ops_id != id)
+			ctx->sampler = NULL;
+	}
+	mutex_unlock(&damon_ops_lock);
+	return err;
+}
+
+/* Should be called under damon_ops_lock */
+static struct damon_sampler *__damon_find_sampler(const char *name,
+		enum damon_ops_id id)
+{
+	struct damon_sampler *sampler;
+
+	list_for_each_entry(sampler, &damon_registered_samplers, list) {
+		if (sampler->ops_id == id && !strcmp(sampler->name, name))
+			return sampler;
+	}
+	return NULL;
+}
+
+/**
+ * damon_register_sampler() - Register an access sampling backend to DAMON.
+ * @sampler:	access sampling backend to register.
+ *
+ * This function registers @sampler so that contexts using the operations set
+ * of &damon_sampler->ops_id can select it by the name later.  @sampler should
+ * be valid until the end of the system.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int damon_register_sampler(struct damon_sampler *sampler)
+{
+	int err = 0;
+
+	if (sampler->ops_id >= NR_DAMON_OPS || !sampler->name ||
+			!sampler->prepare_access_checks ||
+			!sampler->check_accesses)
+		return -EINVAL;
+	mutex_lock(&damon_ops_lock);
+	if (__damon_find_sampler(sampler->name, sampler->ops_id))
+		err = -EINVAL;
+	else
+		list_add_tail(&sampler->list, &damon_registered_samplers);
+	mutex_unlock(&damon_ops_lock);
+	return err;
+}
+
+/**
+ * damon_select_sampler() - Select an access sampling backend for a context.
+ * @ctx:	monitoring context to use the sampler.
+ * @name:	name of the registered sampler, or NULL for the default.
+ *
+ * This function finds the sampler of @name that registered for the operations
+ * set of @ctx and makes @ctx to use it.  The operations set should hence be
+ * selected first.  If @name is NULL or empty, @ctx uses the access sampling
+ * of its operations set.
+ *
+ * Return: 0 on success, negative error code otherwise.
+ */
+int damon_select_sampler(struct damon_ctx *ctx, const char *name)
+{
+	struct damon_sampler *sampler = NULL;
+	int err = 0;
+
+	mutex_lock(&damon_ops_lock);
+	if (name && name[0]) {
+		sampler = __damon_find_sampler(name, ctx->ops.id);
+		if (!sampler)
+			err = -EINVAL;
+	}
+	if (!err)
+		ctx->sampler = sampler;
 	mutex_unlock(&damon_ops_lock);
 	return err;
 }
@@ -127,6 +200,8 @@ struct damon_region *damon_new_region(unsigned long start, unsigned long end)
 
 	region->ar.start = start;
 	region->ar.end = end;
+	/* not sampled yet */
+	region->sampling_addr = end;
 	region->nr_accesses = 0;
 	INIT_LIST_HEAD(&region->list);
 
@@ -1139,6 +1214,30 @@ static int kdamond_wait_activation(struct damon_ctx *ctx)
 	return -EBUSY;
 }
 
+static void kdamond_prepare_access_checks(struct damon_ctx *ctx)
+{
+	u64 start = ktime_get_ns();
+
+	if (ctx->sampler)
+		ctx->sampler->prepare_access_checks(ctx);
+	else if (ctx->ops.prepare_access_checks)
+		ctx->ops.prepare_access_checks(ctx);
+	ctx->sampling_stat.sampling_ns += ktime_get_ns() - start;
+}
+
+static unsigned int kdamond_check_accesses(struct damon_ctx *ctx)
+{
+	u64 start = ktime_get_ns();
+	unsigned int max_nr_accesses = 0;
+
+	if (ctx->sampler)
+		max_nr_accesses = ctx->sampler->check_accesses(ctx);
+	else if (ctx->ops.check_accesses)
+		max_nr_accesses = ctx->ops.check_accesses(ctx);
+	ctx->sampling_stat.sampling_ns += ktime_get_ns() - start;
+	return max_nr_accesses;
+}
+
 /*
  * The monitoring daemon that runs as a kernel thread
  */
@@ -1154,6 +1253,7 @@ static int kdamond_fn(void *data)
 
 	complete(&ctx->kdamond_started);
 
+	ctx->sampling_stat = (struct damon_sampling_stat){};
 	if (ctx->ops.init)
 		ctx->ops.init(ctx);
 	if (ctx->callback.before_start && ctx->callback.before_start(ctx))
@@ -1165,16 +1265,14 @@ static int kdamond_fn(void *data)
 		if (kdamond_wait_activation(ctx))
 			break;
 
-		if (ctx->ops.prepare_access_checks)
-			ctx->ops.prepare_access_checks(ctx);
+		kdamond_prepare_access_checks(ctx);
 		if (ctx->callback.after_sampling &&
 				ctx->callback.after_sampling(ctx))
 			break;
 
 		kdamond_usleep(ctx->attrs.sample_interval);
 
-		if (ctx->ops.check_accesses)
-			max_nr_accesses = ctx->ops.check_accesses(ctx);
+		max_nr_accesses = kdamond_check_accesses(ctx);
 
 		if (kdamond_aggregate_interval_passed(ctx)) {
 			kdamond_merge_regions(ctx,
@@ -1188,6 +1286,8 @@ static int kdamond_fn(void *data)
 			kdamond_split_regions(ctx);
 			if (ctx->ops.reset_aggregated)
 				ctx->ops.reset_aggregated(ctx);
+			if (ctx->sampler && ctx->sampler->reset_aggregated)
+				ctx->sampler->reset_aggregated(ctx);
 		}
 
 		if (kdamond_need_update_operations(ctx)) {
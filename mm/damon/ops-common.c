@@ -33,13 +33,13 @@ struct page *damon_get_page(unsigned long pfn)
 	return page;
 }
 
-void damon_ptep_mkold(pte_t *pte, struct vm_area_struct *vma, unsigned long addr)
+bool damon_ptep_mkold(pte_t *pte, struct vm_area_struct *vma, unsigned long addr)
 {
 	bool referenced = false;
 	struct page *page = damon_get_page(pte_pfn(*pte));
 
 	if (!page)
-		return;
+		return false;
 
 	if (ptep_test_and_clear_young(vma, addr, pte))
 		referenced = true;
@@ -54,16 +54,17 @@ void damon_ptep_mkold(pte_t *pte, struct vm_area_struct *vma, unsigned long addr
 
 	set_page_idle(page);
 	put_page(page);
+	return referenced;
 }
 
-void damon_pmdp_mkold(pmd_t *pmd, struct vm_area_struct *vma, unsigned long addr)
+bool damon_pmdp_mkold(pmd_t *pmd, struct vm_area_struct *vma, unsigned long addr)
 {
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 	bool referenced = false;
 	struct page *page = damon_get_page(pmd_pfn(*pmd));
 
 	if (!page)
-		return;
+		return false;
 
 	if (pmdp_test_and_clear_young(vma, addr, pmd))
 		referenced = true;
@@ -78,6 +79,9 @@ void damon_pmdp_mkold(pmd_t *pmd, struct vm_area_struct *vma, unsigned long addr
 
 	set_page_idle(page);
 	put_page(page);
+	return referenced;
+#else
+	return false;
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 }
 
@@ -31,7 +31,7 @@ static bool __damon_pa_mkold(struct folio *folio, struct vm_area_struct *vma,
 	return true;
 }
 
-static void damon_pa_mkold(unsigned long paddr)
+static void damon_pa_mkold(struct damon_ctx *ctx, unsigned long paddr)
 {
 	struct folio *folio;
 	struct page *page = damon_get_page(PHYS_PFN(paddr));
@@ -55,6 +55,7 @@ static void damon_pa_mkold(unsigned long paddr)
 		goto out;
 
 	rmap_walk(folio, &rwc);
+	ctx->sampling_stat.nr_walks++;
 
 	if (need_lock)
 		folio_unlock(folio);
@@ -63,11 +64,12 @@ static void damon_pa_mkold(unsigned long paddr)
 	folio_put(folio);
 }
 
-static void __damon_pa_prepare_access_check(struct damon_region *r)
+static void __damon_pa_prepare_access_check(struct damon_ctx *ctx,
+		struct damon_region *r)
 {
 	r->sampling_addr = damon_rand(r->ar.start, r->ar.end);
 
-	damon_pa_mkold(r->sampling_addr);
+	damon_pa_mkold(ctx, r->sampling_addr);
 }
 
 static void damon_pa_prepare_access_checks(struct damon_ctx *ctx)
@@ -77,7 +79,7 @@ static void damon_pa_prepare_access_checks(struct damon_ctx *ctx)
 
 	damon_for_each_target(t, ctx) {
 		damon_for_each_region(r, t)
-			__damon_pa_prepare_access_check(r);
+			__damon_pa_prepare_access_check(ctx, r);
 	}
 }
 
@@ -120,7 +122,8 @@ static bool __damon_pa_young(struct folio *folio, struct vm_area_struct *vma,
 	return !result->accessed;
 }
 
-static bool damon_pa_young(unsigned long paddr, unsigned long *page_sz)
+static bool damon_pa_young(struct damon_ctx *ctx, unsigned long paddr,
+		unsigned long *page_sz)
 {
 	struct folio *folio;
 	struct page *page = damon_get_page(PHYS_PFN(paddr));
@@ -155,6 +158,7 @@ static bool damon_pa_young(unsigned long paddr, unsigned long *page_sz)
 	}
 
 	rmap_walk(folio, &rwc);
+	ctx->sampling_stat.nr_walks++;
 
 	if (need_lock)
 		folio_unlock(folio);
@@ -165,12 +169,14 @@ static bool damon_pa_young(unsigned long paddr, unsigned long *page_sz)
 	return result.accessed;
 }
 
-static void __damon_pa_check_access(struct damon_region *r)
+static void __damon_pa_check_access(struct damon_ctx *ctx,
+		struct damon_region *r)
 {
 	static unsigned long last_addr;
 	static unsigned long last_page_sz = PAGE_SIZE;
 	static bool last_accessed;
 
+	ctx->sampling_stat.nr_samples++;
 	/* If the region is in the last checked page, reuse the result */
 	if (ALIGN_DOWN(last_addr, last_page_sz) ==
 				ALIGN_DOWN(r->sampling_addr, last_page_sz)) {
@@ -179,7 +185,7 @@ static void __damon_pa_check_access(struct damon_region *r)
 		return;
 	}
 
-	last_accessed = damon_pa_young(r->sampling_addr, &last_page_sz);
+	last_accessed = damon_pa_young(ctx, r->sampling_addr, &last_page_sz);
 	if (last_accessed)
 		r->nr_accesses++;
 
@@ -194,7 +200,7 @@ static unsigned int damon_pa_check_accesses(struct damon_ctx *ctx)
 
 	damon_for_each_target(t, ctx) {
 		damon_for_each_region(r, t) {
-			__damon_pa_check_access(r);
+			__damon_pa_check_access(ctx, r);
 			max_nr_accesses = max(r->nr_accesses, max_nr_accesses);
 		}
 	}
@@ -202,6 +208,157 @@ static unsigned int damon_pa_check_accesses(struct damon_ctx *ctx)
 	return max_nr_accesses;
 }
 
+/*
+ * The batched sampler
+ *
+ * The default sampling above walks the reverse mappings of each sampled folio
+ * twice per sampling interval: once for clearing the accessed bits of a newly
+ * picked sampling address, and once more for reading those.  The batched
+ * sampler instead keeps the sampling address of each region for a whole
+ * aggregation interval, and reads and clears the accessed bits of the folio in
+ * a single walk.  Hence each mapping of the sampled folios is visited only
+ * once per sampling interval, and a new address is picked and cleared only
+ * after each aggregation or when the region no more covers the address.
+ *
+ * Regions are kept sorted by their addresses, so samples of a target are
+ * already visited in the physical address order and consecutive samples in
+ * the same folio share one walk.
+ */
+
+static bool __damon_pa_young_mkold(struct folio *folio,
+		struct vm_area_struct *vma, unsigned long addr, void *arg)
+{
+	struct damon_pa_access_chk_result *result = arg;
+	DEFINE_FOLIO_VMA_WALK(pvmw, folio, vma, addr, 0);
+
+	while (page_vma_mapped_walk(&pvmw)) {
+		addr = pvmw.address;
+		if (pvmw.pte) {
+			if (damon_ptep_mkold(pvmw.pte, vma, addr))
+				result->accessed = true;
+		} else {
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+			if (damon_pmdp_mkold(pvmw.pmd, vma, addr))
+				result->accessed = true;
+			result->page_sz = HPAGE_PMD_SIZE;
+#else
+			WARN_ON_ONCE(1);
+#endif	/* CONFIG_TRANSPARENT_HUGEPAGE */
+		}
+	}
+	return true;
+}
+
+/*
+ * Check whether the folio of @paddr has accessed since the last call, and
+ * clear its accessed state for the next call.
+ */
+static bool damon_pa_young_mkold(struct damon_ctx *ctx, unsigned long paddr,
+		unsigned long *page_sz)
+{
+	struct folio *folio;
+	struct page *page = damon_get_page(PHYS_PFN(paddr));
+	struct damon_pa_access_chk_result result = {
+		.page_sz = PAGE_SIZE,
+		.accessed = false,
+	};
+	struct rmap_walk_control rwc = {
+		.arg = &result,
+		.rmap_one = __damon_pa_young_mkold,
+		.anon_lock = folio_lock_anon_vma_read,
+	};
+	bool need_lock;
+
+	*page_sz = PAGE_SIZE;
+	if (!page)
+		return false;
+	folio = page_folio(page);
+
+	result.accessed = !folio_test_idle(folio);
+	if (!folio_mapped(folio) || !folio_raw_mapping(folio))
+		goto out;
+
+	need_lock = !folio_test_anon(folio) || folio_test_ksm(folio);
+	if (need_lock && !folio_trylock(folio)) {
+		folio_put(folio);
+		return false;
+	}
+
+	rmap_walk(folio, &rwc);
+	ctx->sampling_stat.nr_walks++;
+
+	if (need_lock)
+		folio_unlock(folio);
+
+out:
+	folio_set_idle(folio);
+	folio_put(folio);
+	*page_sz = result.page_sz;
+	return result.accessed;
+}
+
+static void damon_pa_batch_prepare_access_checks(struct damon_ctx *ctx)
+{
+	struct damon_target *t;
+	struct damon_region *r;
+
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t) {
+			/* Already cleared by the last check */
+			if (r->sampling_addr >= r->ar.start &&
+					r->sampling_addr < r->ar.end)
+				continue;
+			__damon_pa_prepare_access_check(ctx, r);
+		}
+	}
+}
+
+static unsigned int damon_pa_batch_check_accesses(struct damon_ctx *ctx)
+{
+	struct damon_target *t;
+	struct damon_region *r;
+	unsigned long last_addr = 0, last_page_sz = 0;
+	bool last_accessed = false;
+	unsigned int max_nr_accesses = 0;
+
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t) {
+			ctx->sampling_stat.nr_samples++;
+			if (!last_page_sz || ALIGN_DOWN(last_addr, last_page_sz) !=
+					ALIGN_DOWN(r->sampling_addr, last_page_sz)) {
+				last_accessed = damon_pa_young_mkold(ctx,
+						r->sampling_addr, &last_page_sz);
+				last_addr = r->sampling_addr;
+			}
+			if (last_accessed)
+				r->nr_accesses++;
+			max_nr_accesses = max(r->nr_accesses, max_nr_accesses);
+		}
+	}
+
+	return max_nr_accesses;
+}
+
+static void damon_pa_batch_reset_aggregated(struct damon_ctx *ctx)
+{
+	struct damon_target *t;
+	struct damon_region *r;
+
+	/* Pick new sampling addresses for the next aggregation interval */
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t)
+			r->sampling_addr = r->ar.end;
+	}
+}
+
+static struct damon_sampler damon_pa_batch_sampler = {
+	.name = "batched",
+	.ops_id = DAMON_OPS_PADDR,
+	.prepare_access_checks = damon_pa_batch_prepare_access_checks,
+	.check_accesses = damon_pa_batch_check_accesses,
+	.reset_aggregated = damon_pa_batch_reset_aggregated,
+};
+
 static unsigned long damon_pa_pageout(struct damon_region *r)
 {
 	unsigned long addr, applied;
@@ -312,8 +469,12 @@ static int __init damon_pa_initcall(void)
 		.apply_scheme = damon_pa_apply_scheme,
 		.get_scheme_score = damon_pa_scheme_score,
 	};
+	int err;
 
-	return damon_register_ops(&ops);
+	err = damon_register_ops(&ops);
+	if (err)
+		return err;
+	return damon_register_sampler(&damon_pa_batch_sampler);
 };
 
 subsys_initcall(damon_pa_initcall);
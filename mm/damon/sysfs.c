@@ -1685,9 +1685,12 @@ static const char * const damon_sysfs_ops_strs[] = {
 	"paddr",
 };
 
+#define DAMON_SYSFS_SAMPLER_LEN	32
+
 struct damon_sysfs_context {
 	struct kobject kobj;
 	enum damon_ops_id ops_id;
+	char sampler[DAMON_SYSFS_SAMPLER_LEN];
 	struct damon_sysfs_attrs *attrs;
 	struct damon_sysfs_targets *targets;
 	struct damon_sysfs_schemes *schemes;
@@ -1703,6 +1706,7 @@ static struct damon_sysfs_context *damon_sysfs_context_alloc(
 		return NULL;
 	context->kobj = (struct kobject){};
 	context->ops_id = ops_id;
+	context->sampler[0] = '\0';
 	return context;
 }
 
@@ -1838,6 +1842,28 @@ static ssize_t operations_store(struct kobject *kobj,
 	return -EINVAL;
 }
 
+static ssize_t sampler_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_context *context = container_of(kobj,
+			struct damon_sysfs_context, kobj);
+
+	return sysfs_emit(buf, "%s\n", context->sampler);
+}
+
+static ssize_t sampler_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	struct damon_sysfs_context *context = container_of(kobj,
+			struct damon_sysfs_context, kobj);
+	char name[DAMON_SYSFS_SAMPLER_LEN];
+
+	if (strscpy(name, buf, sizeof(name)) < 0)
+		return -EINVAL;
+	strscpy(context->sampler, strim(name), sizeof(context->sampler));
+	return count;
+}
+
 static void damon_sysfs_context_release(struct kobject *kobj)
 {
 	kfree(container_of(kobj, struct damon_sysfs_context, kobj));
@@ -1849,9 +1875,13 @@ static struct kobj_attribute damon_sysfs_context_avail_operations_attr =
 static struct kobj_attribute damon_sysfs_context_operations_attr =
 		__ATTR_RW_MODE(operations, 0600);
 
+static struct kobj_attribute damon_sysfs_context_sampler_attr =
+		__ATTR_RW_MODE(sampler, 0600);
+
 static struct attribute *damon_sysfs_context_attrs[] = {
 	&damon_sysfs_context_avail_operations_attr.attr,
 	&damon_sysfs_context_operations_attr.attr,
+	&damon_sysfs_context_sampler_attr.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(damon_sysfs_context);
@@ -2425,6 +2455,9 @@ static int damon_sysfs_apply_inputs(struct damon_ctx *ctx,
 	int err;
 
 	err = damon_select_ops(ctx, sys_ctx->ops_id);
+	if (err)
+		return err;
+	err = damon_select_sampler(ctx, sys_ctx->sampler);
 	if (err)
 		return err;
 	err = damon_sysfs_set_attrs(ctx, sys_ctx->attrs);
@@ -2655,6 +2688,63 @@ static ssize_t pid_show(struct kobject *kobj,
 	return sysfs_emit(buf, "%d\n", pid);
 }
 
+static int damon_sysfs_kdamond_sampling_stat(
+		struct damon_sysfs_kdamond *kdamond,
+		struct damon_sampling_stat *stat)
+{
+	struct damon_ctx *ctx;
+
+	if (!mutex_trylock(&damon_sysfs_lock))
+		return -EBUSY;
+	ctx = kdamond->damon_ctx;
+	if (ctx)
+		*stat = ctx->sampling_stat;
+	else
+		*stat = (struct damon_sampling_stat){};
+	mutex_unlock(&damon_sysfs_lock);
+	return 0;
+}
+
+static ssize_t nr_samples_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_kdamond *kdamond = container_of(kobj,
+			struct damon_sysfs_kdamond, kobj);
+	struct damon_sampling_stat stat;
+	int err = damon_sysfs_kdamond_sampling_stat(kdamond, &stat);
+
+	if (err)
+		return err;
+	return sysfs_emit(buf, "%lu\n", stat.nr_samples);
+}
+
+static ssize_t nr_walks_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_kdamond *kdamond = container_of(kobj,
+			struct damon_sysfs_kdamond, kobj);
+	struct damon_sampling_stat stat;
+	int err = damon_sysfs_kdamond_sampling_stat(kdamond, &stat);
+
+	if (err)
+		return err;
+	return sysfs_emit(buf, "%lu\n", stat.nr_walks);
+}
+
+static ssize_t sampling_us_show(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	struct damon_sysfs_kdamond *kdamond = container_of(kobj,
+			struct damon_sysfs_kdamond, kobj);
+	struct damon_sampling_stat stat;
+	int err = damon_sysfs_kdamond_sampling_stat(kdamond, &stat);
+
+	if (err)
+		return err;
+	return sysfs_emit(buf, "%llu\n", div_u64(stat.sampling_ns,
+				NSEC_PER_USEC));
+}
+
 static void damon_sysfs_kdamond_release(struct kobject *kobj)
 {
 	struct damon_sysfs_kdamond *kdamond = container_of(kobj,
@@ -2671,9 +2761,21 @@ static struct kobj_attribute damon_sysfs_kdamond_state_attr =
 static struct kobj_attribute damon_sysfs_kdamond_pid_attr =
 		__ATTR_RO_MODE(pid, 0400);
 
+static struct kobj_attribute damon_sysfs_kdamond_nr_samples_attr =
+		__ATTR_RO_MODE(nr_samples, 0400);
+
+static struct kobj_attribute damon_sysfs_kdamond_nr_walks_attr =
+		__ATTR_RO_MODE(nr_walks, 0400);
+
+static struct kobj_attribute damon_sysfs_kdamond_sampling_us_attr =
+		__ATTR_RO_MODE(sampling_us, 0400);
+
 static struct attribute *damon_sysfs_kdamond_attrs[] = {
 	&damon_sysfs_kdamond_state_attr.attr,
 	&damon_sysfs_kdamond_pid_attr.attr,
+	&damon_sysfs_kdamond_nr_samples_attr.attr,
+	&damon_sysfs_kdamond_nr_walks_attr.attr,
+	&damon_sysfs_kdamond_sampling_us_attr.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(damon_sysfs_kdamond);
@@ -219,6 +219,9 @@ void __filemap_remove_folio(struct folio *folio, void *shadow)
 	struct address_space *mapping = folio->mapping;
 
 	trace_mm_filemap_delete_from_page_cache(folio);
+	/* PG_readahead doubles as PG_reclaim while under writeback */
+	if (folio_test_readahead(folio) && !folio_test_writeback(folio))
+		bdi_ra_stat_inc(inode_to_bdi(mapping->host), BDI_RA_WASTE);
 	filemap_unaccount_folio(mapping, folio);
 	page_cache_delete(mapping, folio, shadow);
 }
@@ -2673,6 +2676,21 @@ static int filemap_get_pages(struct kiocb *iocb, struct iov_iter *iter,
 	return err;
 }
 
+/*
+ * Without highmem, a large folio is contiguous in the direct map: copy the
+ * whole range in one go instead of kmapping and copying it page by page.
+ * Pipes still take page references one page at a time.
+ */
+static size_t filemap_copy_folio_to_iter(struct folio *folio, size_t offset,
+		size_t bytes, struct iov_iter *iter)
+{
+	if (!IS_ENABLED(CONFIG_HIGHMEM) && folio_test_large(folio) &&
+	    !iov_iter_is_pipe(iter))
+		return copy_to_iter(folio_address(folio) + offset, bytes, iter);
+
+	return copy_folio_to_iter(folio, offset, bytes, iter);
+}
+
 static inline bool pos_same_folio(loff_t pos1, loff_t pos2, struct folio *folio)
 {
 	unsigned int shift = folio_shift(folio);
@@ -2701,7 +2719,7 @@ ssize_t filemap_read(struct kiocb *iocb, struct iov_iter *iter,
 	struct address_space *mapping = filp->f_mapping;
 	struct inode *inode = mapping->host;
 	struct folio_batch fbatch;
-	int i, error = 0;
+	int i, first_accessed, nr_accessed, error = 0;
 	bool writably_mapped;
 	loff_t isize, end_offset;
 
@@ -2763,9 +2781,8 @@ ssize_t filemap_read(struct kiocb *iocb, struct iov_iter *iter,
 		 * When a read accesses the same folio several times, only
 		 * mark it as accessed the first time.
 		 */
-		if (!pos_same_folio(iocb->ki_pos, ra->prev_pos - 1,
-							fbatch.folios[0]))
-			folio_mark_accessed(fbatch.folios[0]);
+		first_accessed = pos_same_folio(iocb->ki_pos, ra->prev_pos - 1,
+						fbatch.folios[0]) ? 1 : 0;
 
 		for (i = 0; i < folio_batch_count(&fbatch); i++) {
 			struct folio *folio = fbatch.folios[i];
@@ -2777,8 +2794,6 @@ ssize_t filemap_read(struct kiocb *iocb, struct iov_iter *iter,
 
 			if (end_offset < folio_pos(folio))
 				break;
-			if (i > 0)
-				folio_mark_accessed(folio);
 			/*
 			 * If users can be writing to this folio using arbitrary
 			 * virtual addresses, take care of potential aliasing
@@ -2787,7 +2802,8 @@ ssize_t filemap_read(struct kiocb *iocb, struct iov_iter *iter,
 			if (writably_mapped)
 				flush_dcache_folio(folio);
 
-			copied = copy_folio_to_iter(folio, offset, bytes, iter);
+			copied = filemap_copy_folio_to_iter(folio, offset, bytes,
+							    iter);
 
 			already_read += copied;
 			iocb->ki_pos += copied;
@@ -2795,9 +2811,18 @@ ssize_t filemap_read(struct kiocb *iocb, struct iov_iter *iter,
 
 			if (copied < bytes) {
 				error = -EFAULT;
+				i++;
 				break;
 			}
 		}
+
+		/*
+		 * Keep the LRU updates out of the copy loop, which then only
+		 * touches the folios' data: mark what was read in one go.
+		 */
+		nr_accessed = i;
+		for (i = first_accessed; i < nr_accessed; i++)
+			folio_mark_accessed(fbatch.folios[i]);
 put_folios:
 		for (i = 0; i < folio_batch_count(&fbatch); i++)
 			folio_put(fbatch.folios[i]);
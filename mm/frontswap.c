@@ -153,12 +153,38 @@ static inline void __frontswap_clear(struct swap_info_struct *sis,
 	atomic_dec(&sis->frontswap_pages);
 }
 
+/*
+ * Store the nr subpages of a large folio. Backends that don't provide a
+ * batched store get one call per subpage; in either case the folio is
+ * only considered stored if every subpage was.
+ */
+static int __frontswap_store_batch(unsigned type, pgoff_t offset,
+				   struct page *page, unsigned int nr)
+{
+	unsigned int i;
+	int ret;
+
+	if (frontswap_ops->store_batch)
+		return frontswap_ops->store_batch(type, offset, page, nr);
+
+	for (i = 0; i < nr; i++) {
+		ret = frontswap_ops->store(type, offset + i, nth_page(page, i));
+		if (ret) {
+			while (i--)
+				frontswap_ops->invalidate_page(type, offset + i);
+			return ret;
+		}
+	}
+	return 0;
+}
+
 /*
  * "Store" data from a page to frontswap and associate it with the page's
  * swaptype and offset.  Page must be locked and in the swap cache.
  * If frontswap already contains a page with matching swaptype and
  * offset, the frontswap implementation may either overwrite the data and
  * return success or invalidate the page from frontswap and return failure.
+ * A large folio is stored as a whole, covering one offset per subpage.
  */
 int __frontswap_store(struct page *page)
 {
@@ -167,6 +193,7 @@ int __frontswap_store(struct page *page)
 	int type = swp_type(entry);
 	struct swap_info_struct *sis = swap_info[type];
 	pgoff_t offset = swp_offset(entry);
+	unsigned int i, nr = thp_nr_pages(page);
 
 	VM_BUG_ON(!frontswap_ops);
 	VM_BUG_ON(!PageLocked(page));
@@ -178,14 +205,20 @@ int __frontswap_store(struct page *page)
 	 * and we can't rely on the new page replacing the old page as we may
 	 * not store to the same implementation that contains the old page.
 	 */
-	if (__frontswap_test(sis, offset)) {
-		__frontswap_clear(sis, offset);
-		frontswap_ops->invalidate_page(type, offset);
+	for (i = 0; i < nr; i++) {
+		if (__frontswap_test(sis, offset + i)) {
+			__frontswap_clear(sis, offset + i);
+			frontswap_ops->invalidate_page(type, offset + i);
+		}
 	}
 
-	ret = frontswap_ops->store(type, offset, page);
+	if (nr == 1)
+		ret = frontswap_ops->store(type, offset, page);
+	else
+		ret = __frontswap_store_batch(type, offset, page, nr);
 	if (ret == 0) {
-		__frontswap_set(sis, offset);
+		for (i = 0; i < nr; i++)
+			__frontswap_set(sis, offset + i);
 		inc_frontswap_succ_stores();
 	} else {
 		inc_frontswap_failed_stores();
@@ -194,10 +227,35 @@ int __frontswap_store(struct page *page)
 	return ret;
 }
 
+static int __frontswap_load_batch(unsigned type, pgoff_t offset,
+				  struct page *page, unsigned int nr)
+{
+	unsigned int i;
+	int ret;
+
+	if (frontswap_ops->load_batch)
+		return frontswap_ops->load_batch(type, offset, page, nr);
+
+	for (i = 0; i < nr; i++) {
+		ret = frontswap_ops->load(type, offset + i, nth_page(page, i));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
 /*
  * "Get" data from frontswap associated with swaptype and offset that were
  * specified when the data was put to frontswap and use it to fill the
  * specified page with data. Page must be locked and in the swap cache.
+ *
+ * A large folio is only loaded if frontswap can fill every one of its
+ * subpages. The frontswap bit of a subpage stays set when the backend
+ * writes its copy back to the swap device, so the bitmap alone does not
+ * tell where each subpage lives: if frontswap holds any of them but cannot
+ * fill them all, -EAGAIN tells the caller that neither frontswap nor the
+ * swap device has the whole folio, and that it must be swapped in page by
+ * page instead. -1 still means that none of the subpages is in frontswap.
  */
 int __frontswap_load(struct page *page)
 {
@@ -206,19 +264,51 @@ int __frontswap_load(struct page *page)
 	int type = swp_type(entry);
 	struct swap_info_struct *sis = swap_info[type];
 	pgoff_t offset = swp_offset(entry);
+	unsigned int i, nr = thp_nr_pages(page);
 
 	VM_BUG_ON(!frontswap_ops);
 	VM_BUG_ON(!PageLocked(page));
 	VM_BUG_ON(sis == NULL);
 
-	if (!__frontswap_test(sis, offset))
+	if (nr == 1) {
+		if (!__frontswap_test(sis, offset))
+			return -1;
+		/* Try loading from each implementation, until one succeeds. */
+		ret = frontswap_ops->load(type, offset, page);
+		if (ret == 0)
+			inc_frontswap_loads();
+		return ret;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (__frontswap_test(sis, offset + i))
+			break;
+	}
+	if (i == nr)
 		return -1;
 
-	/* Try loading from each implementation, until one succeeds. */
-	ret = frontswap_ops->load(type, offset, page);
-	if (ret == 0)
-		inc_frontswap_loads();
-	return ret;
+	for (; i < nr; i++) {
+		if (!__frontswap_test(sis, offset + i))
+			return -EAGAIN;
+	}
+
+	if (__frontswap_load_batch(type, offset, page, nr))
+		return -EAGAIN;
+	inc_frontswap_loads();
+	return 0;
+}
+
+bool __frontswap_test_uniform(unsigned type, pgoff_t offset, unsigned int nr)
+{
+	struct swap_info_struct *sis = swap_info[type];
+	bool first = __frontswap_test(sis, offset);
+	unsigned int i;
+
+	for (i = 1; i < nr; i++) {
+		if (__frontswap_test(sis, offset + i) != first)
+			return false;
+	}
+	return true;
 }
 
 /*
@@ -34,6 +34,8 @@
 #include <linux/nospec.h>
 #include <linux/delayacct.h>
 #include <linux/memory.h>
+#include <linux/kthread.h>
+#include <linux/freezer.h>
 
 #include <asm/page.h>
 #include <asm/pgalloc.h>
@@ -1314,6 +1316,39 @@ static bool vma_has_reserves(struct vm_area_struct *vma, long chg)
 	return false;
 }
 
+/*
+ * Free pages can be cleared in advance by khugetlb_zerod, so that faults on
+ * them do not have to wait for clear_huge_page().  It keeps up to
+ * prezero_huge_pages_node[nid] cleared pages on each node.  Cleared pages are
+ * kept at the head of the free lists, and the others at the tail, so that
+ * cleared pages are handed out first.
+ *
+ * A page being cleared is off the free list but still accounted in the free
+ * counts (and in zeroing_huge_pages), so that reservations and surplus
+ * accounting do not see the pool shrink.  alloc_huge_page() waits on
+ * hugetlb_zeroing_wait when such a page is the only one it could get.
+ */
+static DECLARE_WAIT_QUEUE_HEAD(hugetlb_prezero_wait);
+static DECLARE_WAIT_QUEUE_HEAD(hugetlb_zeroing_wait);
+static bool hugetlb_prezero_kicked;
+
+static bool hugetlb_prezero_needed(struct hstate *h, int nid)
+{
+	unsigned int busy = h->zeroed_huge_pages_node[nid] +
+			    h->zeroing_huge_pages_node[nid];
+
+	return busy < h->prezero_huge_pages_node[nid] &&
+		h->free_huge_pages_node[nid] > busy;
+}
+
+static void hugetlb_prezero_wake(struct hstate *h, int nid)
+{
+	if (!hugetlb_prezero_needed(h, nid))
+		return;
+	WRITE_ONCE(hugetlb_prezero_kicked, true);
+	wake_up_interruptible(&hugetlb_prezero_wait);
+}
+
 static void enqueue_huge_page(struct hstate *h, struct page *page)
 {
 	int nid = page_to_nid(page);
@@ -1321,10 +1356,19 @@ static void enqueue_huge_page(struct hstate *h, struct page *page)
 	lockdep_assert_held(&hugetlb_lock);
 	VM_BUG_ON_PAGE(page_count(page), page);
 
-	list_move(&page->lru, &h->hugepage_freelists[nid]);
+	if (HPageZeroed(page)) {
+		list_move(&page->lru, &h->hugepage_freelists[nid]);
+		h->zeroed_huge_pages++;
+		h->zeroed_huge_pages_node[nid]++;
+	} else if (h->zeroed_huge_pages_node[nid]) {
+		list_move_tail(&page->lru, &h->hugepage_freelists[nid]);
+	} else {
+		list_move(&page->lru, &h->hugepage_freelists[nid]);
+	}
 	h->free_huge_pages++;
 	h->free_huge_pages_node[nid]++;
 	SetHPageFreed(page);
+	hugetlb_prezero_wake(h, nid);
 }
 
 static struct page *dequeue_huge_page_node_exact(struct hstate *h, int nid)
@@ -1345,6 +1389,11 @@ static struct page *dequeue_huge_page_node_exact(struct hstate *h, int nid)
 		ClearHPageFreed(page);
 		h->free_huge_pages--;
 		h->free_huge_pages_node[nid]--;
+		if (HPageZeroed(page)) {
+			h->zeroed_huge_pages--;
+			h->zeroed_huge_pages_node[nid]--;
+		}
+		hugetlb_prezero_wake(h, nid);
 		return page;
 	}
 
@@ -1675,6 +1724,11 @@ static void __remove_hugetlb_page(struct hstate *h, struct page *page,
 	if (HPageFreed(page)) {
 		h->free_huge_pages--;
 		h->free_huge_pages_node[nid]--;
+		if (HPageZeroed(page)) {
+			h->zeroed_huge_pages--;
+			h->zeroed_huge_pages_node[nid]--;
+			ClearHPageZeroed(page);
+		}
 	}
 	if (adjust_surplus) {
 		h->surplus_huge_pages--;
@@ -1933,6 +1987,7 @@ void free_huge_page(struct page *page)
 	folio->mapping = NULL;
 	restore_reserve = folio_test_hugetlb_restore_reserve(folio);
 	folio_clear_hugetlb_restore_reserve(folio);
+	folio_clear_hugetlb_zeroed(folio);
 
 	/*
 	 * If HPageRestoreReserve was set on page, page allocation consumed a
@@ -2312,8 +2367,9 @@ static struct page *remove_pool_huge_page(struct hstate *h,
 		 */
 		if ((!acct_surplus || h->surplus_huge_pages_node[node]) &&
 		    !list_empty(&h->hugepage_freelists[node])) {
-			page = list_entry(h->hugepage_freelists[node].next,
-					  struct page, lru);
+			/* Pre-zeroed pages are at the head, keep those */
+			page = list_last_entry(&h->hugepage_freelists[node],
+					       struct page, lru);
 			remove_hugetlb_page(h, page, acct_surplus);
 			break;
 		}
@@ -3139,6 +3195,7 @@ struct page *alloc_huge_page(struct vm_area_struct *vma,
 		goto out_uncharge_cgroup_reservation;
 
 	spin_lock_irq(&hugetlb_lock);
+retry:
 	/*
 	 * glb_chg is passed to indicate whether or not a page must be taken
 	 * from the global free pool (global change).  gbl_chg == 0 indicates
@@ -3146,6 +3203,20 @@ struct page *alloc_huge_page(struct vm_area_struct *vma,
 	 */
 	page = dequeue_huge_page_vma(h, vma, addr, avoid_reserve, gbl_chg);
 
+	if (!page && h->zeroing_huge_pages &&
+	    ((!avoid_reserve && vma_has_reserves(vma, gbl_chg)) ||
+	     h->free_huge_pages > h->resv_huge_pages)) {
+		/*
+		 * khugetlb_zerod holds a free page that may be the one this
+		 * allocation is entitled to; wait for it to be put back.
+		 */
+		spin_unlock_irq(&hugetlb_lock);
+		wait_event(hugetlb_zeroing_wait,
+			   !READ_ONCE(h->zeroing_huge_pages));
+		spin_lock_irq(&hugetlb_lock);
+		goto retry;
+	}
+
 	if (!page) {
 		spin_unlock_irq(&hugetlb_lock);
 		page = alloc_buddy_huge_page_with_mpol(h, vma, addr);
@@ -3937,6 +4008,198 @@ static ssize_t surplus_hugepages_show(struct kobject *kobj,
 }
 HSTATE_ATTR_RO(surplus_hugepages);
 
+static struct task_struct *hugetlb_prezero_thread;
+
+static struct page *hugetlb_prezero_isolate(struct hstate *h, int nid)
+{
+	struct page *page;
+
+	lockdep_assert_held(&hugetlb_lock);
+	if (!hugetlb_prezero_needed(h, nid))
+		return NULL;
+
+	/* Cleared pages sit at the head, so scan from the tail up to them */
+	list_for_each_entry_reverse(page, &h->hugepage_freelists[nid], lru) {
+		if (HPageZeroed(page))
+			break;
+		if (PageHWPoison(page))
+			continue;
+
+		/*
+		 * Take the page off the free list, but leave it accounted as
+		 * free.  The reference makes dissolve_free_huge_page() back
+		 * off while the page is being cleared.
+		 */
+		list_move(&page->lru, &h->hugepage_activelist);
+		set_page_refcounted(page);
+		ClearHPageFreed(page);
+		h->zeroing_huge_pages++;
+		h->zeroing_huge_pages_node[nid]++;
+		return page;
+	}
+
+	return NULL;
+}
+
+static void hugetlb_prezero_putback(struct hstate *h, struct page *page)
+{
+	int nid = page_to_nid(page);
+
+	spin_lock_irq(&hugetlb_lock);
+	/*
+	 * Drop the free accounting taken over from the free list; the page
+	 * is accounted again below, or by free_huge_page() if someone took
+	 * a speculative reference meanwhile.
+	 */
+	h->zeroing_huge_pages--;
+	h->zeroing_huge_pages_node[nid]--;
+	h->free_huge_pages--;
+	h->free_huge_pages_node[nid]--;
+	if (!put_page_testzero(page)) {
+		spin_unlock_irq(&hugetlb_lock);
+		goto out;
+	}
+
+	if (h->surplus_huge_pages_node[nid]) {
+		/* The pool was shrunk while the page was being cleared */
+		remove_hugetlb_page(h, page, true);
+		spin_unlock_irq(&hugetlb_lock);
+		update_and_free_page(h, page, true);
+		goto out;
+	}
+	SetHPageZeroed(page);
+	enqueue_huge_page(h, page);
+	spin_unlock_irq(&hugetlb_lock);
+out:
+	wake_up(&hugetlb_zeroing_wait);
+}
+
+static int hugetlb_prezero_fn(void *unused)
+{
+	struct hstate *h;
+	struct page *page;
+	int nid;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(hugetlb_prezero_wait,
+				     READ_ONCE(hugetlb_prezero_kicked) ||
+				     kthread_should_stop());
+		WRITE_ONCE(hugetlb_prezero_kicked, false);
+
+		for_each_hstate(h) {
+			for_each_node_state(nid, N_MEMORY) {
+				while (!kthread_should_stop()) {
+					spin_lock_irq(&hugetlb_lock);
+					page = hugetlb_prezero_isolate(h, nid);
+					spin_unlock_irq(&hugetlb_lock);
+					if (!page)
+						break;
+
+					clear_huge_page(page, 0,
+							pages_per_huge_page(h));
+					hugetlb_prezero_putback(h, page);
+					cond_resched();
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static int hugetlb_prezero_start(void)
+{
+	static DEFINE_MUTEX(prezero_mutex);
+	struct task_struct *thread;
+	int err = 0;
+
+	mutex_lock(&prezero_mutex);
+	if (!hugetlb_prezero_thread) {
+		thread = kthread_run(hugetlb_prezero_fn, NULL, "khugetlb_zerod");
+		if (IS_ERR(thread))
+			err = PTR_ERR(thread);
+		else
+			hugetlb_prezero_thread = thread;
+	}
+	mutex_unlock(&prezero_mutex);
+	return err;
+}
+
+static ssize_t prezero_hugepages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h;
+	unsigned long prezero_huge_pages = 0;
+	int nid, node;
+
+	h = kobj_to_hstate(kobj, &nid);
+	if (nid == NUMA_NO_NODE) {
+		for_each_node_state(node, N_MEMORY)
+			prezero_huge_pages += h->prezero_huge_pages_node[node];
+	} else {
+		prezero_huge_pages = h->prezero_huge_pages_node[nid];
+	}
+
+	return sysfs_emit(buf, "%lu\n", prezero_huge_pages);
+}
+
+static ssize_t prezero_hugepages_store(struct kobject *kobj,
+	       struct kobj_attribute *attr, const char *buf, size_t len)
+{
+	struct hstate *h;
+	unsigned long count;
+	int nid, node, nr_nodes, i = 0;
+	int err;
+
+	err = kstrtoul(buf, 10, &count);
+	if (err)
+		return err;
+	if (count) {
+		err = hugetlb_prezero_start();
+		if (err)
+			return err;
+	}
+
+	h = kobj_to_hstate(kobj, &nid);
+	spin_lock_irq(&hugetlb_lock);
+	if (nid != NUMA_NO_NODE) {
+		h->prezero_huge_pages_node[nid] = min_t(unsigned long, count,
+							UINT_MAX);
+	} else {
+		/* Spread the reserve over the nodes with memory */
+		nr_nodes = num_node_state(N_MEMORY);
+		for_each_node_state(node, N_MEMORY) {
+			h->prezero_huge_pages_node[node] = min_t(unsigned long,
+					count / nr_nodes + (i < count % nr_nodes),
+					UINT_MAX);
+			i++;
+		}
+	}
+	spin_unlock_irq(&hugetlb_lock);
+
+	WRITE_ONCE(hugetlb_prezero_kicked, true);
+	wake_up_interruptible(&hugetlb_prezero_wait);
+	return len;
+}
+HSTATE_ATTR(prezero_hugepages);
+
+static ssize_t zeroed_hugepages_show(struct kobject *kobj,
+					struct kobj_attribute *attr, char *buf)
+{
+	struct hstate *h;
+	unsigned long zeroed_huge_pages;
+	int nid;
+
+	h = kobj_to_hstate(kobj, &nid);
+	if (nid == NUMA_NO_NODE)
+		zeroed_huge_pages = h->zeroed_huge_pages;
+	else
+		zeroed_huge_pages = h->zeroed_huge_pages_node[nid];
+
+	return sysfs_emit(buf, "%lu\n", zeroed_huge_pages);
+}
+HSTATE_ATTR_RO(zeroed_hugepages);
+
 static ssize_t demote_store(struct kobject *kobj,
 	       struct kobj_attribute *attr, const char *buf, size_t len)
 {
@@ -4038,6 +4301,8 @@ static struct attribute *hstate_attrs[] = {
 	&free_hugepages_attr.attr,
 	&resv_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&prezero_hugepages_attr.attr,
+	&zeroed_hugepages_attr.attr,
 #ifdef CONFIG_NUMA
 	&nr_hugepages_mempolicy_attr.attr,
 #endif
@@ -4114,6 +4379,8 @@ static struct attribute *per_node_hstate_attrs[] = {
 	&nr_hugepages_attr.attr,
 	&free_hugepages_attr.attr,
 	&surplus_hugepages_attr.attr,
+	&prezero_hugepages_attr.attr,
+	&zeroed_hugepages_attr.attr,
 	NULL,
 };
 
@@ -5916,7 +6183,10 @@ static vm_fault_t hugetlb_no_page(struct mm_struct *mm,
 				ret = 0;
 			goto out;
 		}
-		clear_huge_page(page, address, pages_per_huge_page(h));
+		if (HPageZeroed(page))
+			ClearHPageZeroed(page);
+		else
+			clear_huge_page(page, address, pages_per_huge_page(h));
 		__SetPageUptodate(page);
 		new_page = true;
 
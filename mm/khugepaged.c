@@ -19,6 +19,7 @@
 #include <linux/page_table_check.h>
 #include <linux/swapops.h>
 #include <linux/shmem_fs.h>
+#include <linux/sort.h>
 
 #include <asm/tlb.h>
 #include <asm/pgalloc.h>
@@ -84,6 +85,16 @@ static unsigned int khugepaged_max_ptes_none __read_mostly;
 static unsigned int khugepaged_max_ptes_swap __read_mostly;
 static unsigned int khugepaged_max_ptes_shared __read_mostly;
 
+/*
+ * With hot_scan enabled, khugepaged ranks the anonymous PMD ranges it visits
+ * by the number of recently accessed pages and, at the end of each visit to
+ * an mm, collapses the hottest ones first. At most hot_collapse_budget ranges
+ * are collapsed per mm and full scan, so cold address space is never paid
+ * for with hugepage allocations and copies.
+ */
+static bool khugepaged_hot_scan __read_mostly;
+static unsigned int khugepaged_hot_collapse_budget __read_mostly = 8;
+
 #define MM_SLOTS_HASH_BITS 10
 static __read_mostly DEFINE_HASHTABLE(mm_slots_hash, MM_SLOTS_HASH_BITS);
 
@@ -115,11 +126,21 @@ struct khugepaged_mm_slot {
 	unsigned long pte_mapped_thp[MAX_PTE_MAPPED_THP];
 };
 
+#define KHUGEPAGED_HOT_CANDIDATES 64
+
+struct khugepaged_hot_candidate {
+	unsigned long address;
+	unsigned int hotness;
+};
+
 /**
  * struct khugepaged_scan - cursor for scanning
  * @mm_head: the head of the mm list to scan
  * @mm_slot: the current mm_slot we are scanning
  * @address: the next address inside that to be scanned
+ * @hot: PMD ranges of the current mm ranked for hot_scan collapse
+ * @nr_hot: number of valid entries in @hot
+ * @nr_hot_collapsed: hot_scan collapses in the current mm during this pass
  *
  * There is only the one khugepaged_scan instance of this cursor structure.
  */
@@ -127,6 +148,9 @@ struct khugepaged_scan {
 	struct list_head mm_head;
 	struct khugepaged_mm_slot *mm_slot;
 	unsigned long address;
+	struct khugepaged_hot_candidate hot[KHUGEPAGED_HOT_CANDIDATES];
+	unsigned int nr_hot;
+	unsigned int nr_hot_collapsed;
 };
 
 static struct khugepaged_scan khugepaged_scan = {
@@ -230,6 +254,56 @@ static ssize_t full_scans_show(struct kobject *kobj,
 static struct kobj_attribute full_scans_attr =
 	__ATTR_RO(full_scans);
 
+static ssize_t hot_scan_show(struct kobject *kobj,
+			     struct kobj_attribute *attr,
+			     char *buf)
+{
+	return sysfs_emit(buf, "%d\n", khugepaged_hot_scan);
+}
+
+static ssize_t hot_scan_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	bool enable;
+	int err;
+
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return -EINVAL;
+
+	WRITE_ONCE(khugepaged_hot_scan, enable);
+
+	return count;
+}
+static struct kobj_attribute hot_scan_attr =
+	__ATTR_RW(hot_scan);
+
+static ssize_t hot_collapse_budget_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *buf)
+{
+	return sysfs_emit(buf, "%u\n", khugepaged_hot_collapse_budget);
+}
+
+static ssize_t hot_collapse_budget_store(struct kobject *kobj,
+					 struct kobj_attribute *attr,
+					 const char *buf, size_t count)
+{
+	unsigned int budget;
+	int err;
+
+	err = kstrtouint(buf, 10, &budget);
+	if (err || !budget)
+		return -EINVAL;
+
+	WRITE_ONCE(khugepaged_hot_collapse_budget, budget);
+
+	return count;
+}
+static struct kobj_attribute hot_collapse_budget_attr =
+	__ATTR_RW(hot_collapse_budget);
+
 static ssize_t defrag_show(struct kobject *kobj,
 			   struct kobj_attribute *attr, char *buf)
 {
@@ -338,6 +412,8 @@ static struct attribute *khugepaged_attr[] = {
 	&pages_to_scan_attr.attr,
 	&pages_collapsed_attr.attr,
 	&full_scans_attr.attr,
+	&hot_scan_attr.attr,
+	&hot_collapse_budget_attr.attr,
 	&scan_sleep_millisecs_attr.attr,
 	&alloc_sleep_millisecs_attr.attr,
 	NULL,
@@ -2251,6 +2327,157 @@ static bool khugepaged_add_pte_mapped_thp(struct mm_struct *mm,
 }
 #endif
 
+#ifdef CONFIG_LRU_GEN
+static bool hpage_collapse_folio_active(struct folio *folio)
+{
+	int gen;
+
+	if (!lru_gen_enabled())
+		return false;
+
+	gen = folio_lru_gen(folio);
+	return gen >= 0 && lru_gen_is_active(folio_lruvec(folio), gen);
+}
+#else
+static inline bool hpage_collapse_folio_active(struct folio *folio)
+{
+	return false;
+}
+#endif
+
+/*
+ * Count the pages in the PMD range at @address that were accessed recently:
+ * the pte or the page is young, or the folio is in one of the two youngest
+ * multi-gen LRU generations.
+ */
+static unsigned int hpage_collapse_pmd_hotness(struct mm_struct *mm,
+					       struct vm_area_struct *vma,
+					       unsigned long address)
+{
+	unsigned int hotness = 0;
+	unsigned long _address;
+	pte_t *pte, *_pte;
+	spinlock_t *ptl;
+	pmd_t *pmd;
+
+	if (find_pmd_or_thp_or_none(mm, address, &pmd) != SCAN_SUCCEED)
+		return 0;
+
+	pte = pte_offset_map_lock(mm, pmd, address, &ptl);
+	/* folio_lruvec() needs the memcg to stay around */
+	rcu_read_lock();
+	for (_address = address, _pte = pte; _pte < pte + HPAGE_PMD_NR;
+	     _pte++, _address += PAGE_SIZE) {
+		pte_t pteval = *_pte;
+		struct page *page;
+
+		if (!pte_present(pteval))
+			continue;
+
+		page = vm_normal_page(vma, _address, pteval);
+		if (!page || is_zone_device_page(page))
+			continue;
+
+		if (pte_young(pteval) || page_is_young(page) ||
+		    PageReferenced(page) ||
+		    hpage_collapse_folio_active(page_folio(page)))
+			hotness++;
+	}
+	rcu_read_unlock();
+	pte_unmap_unlock(pte, ptl);
+
+	return hotness;
+}
+
+/* Remember a hot PMD range, replacing the coldest one if there is no room */
+static void khugepaged_rank_pmd(struct mm_struct *mm,
+				struct vm_area_struct *vma,
+				unsigned long address)
+{
+	struct khugepaged_hot_candidate *hot = khugepaged_scan.hot;
+	unsigned int hotness;
+	int i, coldest = 0;
+
+	hotness = hpage_collapse_pmd_hotness(mm, vma, address);
+	if (!hotness)
+		return;
+
+	if (khugepaged_scan.nr_hot < KHUGEPAGED_HOT_CANDIDATES) {
+		i = khugepaged_scan.nr_hot++;
+	} else {
+		for (i = 1; i < KHUGEPAGED_HOT_CANDIDATES; i++)
+			if (hot[i].hotness < hot[coldest].hotness)
+				coldest = i;
+		if (hotness <= hot[coldest].hotness)
+			return;
+		i = coldest;
+	}
+
+	hot[i].address = address;
+	hot[i].hotness = hotness;
+}
+
+static int khugepaged_hot_cmp(const void *a, const void *b)
+{
+	const struct khugepaged_hot_candidate *x = a, *y = b;
+
+	return (int)y->hotness - (int)x->hotness;
+}
+
+/*
+ * Collapse the ranked PMD ranges of @mm, hottest first, until the per-mm
+ * budget for this pass is used up. Called without mmap_lock held.
+ */
+static void khugepaged_collapse_hot(struct mm_struct *mm, int *result,
+				    struct collapse_control *cc)
+{
+	struct khugepaged_hot_candidate *hot = khugepaged_scan.hot;
+	unsigned int i;
+
+	sort(hot, khugepaged_scan.nr_hot, sizeof(*hot), khugepaged_hot_cmp,
+	     NULL);
+
+	for (i = 0; i < khugepaged_scan.nr_hot; i++) {
+		unsigned long address = hot[i].address;
+		struct vm_area_struct *vma;
+		bool mmap_locked = true;
+
+		if (khugepaged_scan.nr_hot_collapsed >=
+		    READ_ONCE(khugepaged_hot_collapse_budget))
+			break;
+
+		cond_resched();
+		if (unlikely(!mmap_read_trylock(mm)))
+			break;
+		if (unlikely(hpage_collapse_test_exit(mm))) {
+			mmap_read_unlock(mm);
+			break;
+		}
+
+		/* The mmap_lock was dropped since ranking, recheck the vma */
+		vma = vma_lookup(mm, address);
+		if (!vma || vma->vm_file ||
+		    address + HPAGE_PMD_SIZE > vma->vm_end ||
+		    !hugepage_vma_check(vma, vma->vm_flags, false, false, true)) {
+			mmap_read_unlock(mm);
+			continue;
+		}
+
+		*result = hpage_collapse_scan_pmd(mm, vma, address,
+						  &mmap_locked, cc);
+		if (mmap_locked)
+			mmap_read_unlock(mm);
+
+		if (*result == SCAN_SUCCEED) {
+			++khugepaged_pages_collapsed;
+			khugepaged_scan.nr_hot_collapsed++;
+		} else if (*result == SCAN_ALLOC_HUGE_PAGE_FAIL) {
+			break;
+		}
+	}
+	khugepaged_scan.nr_hot = 0;
+}
+
 static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 					    struct collapse_control *cc)
 	__releases(&khugepaged_mm_lock)
@@ -2275,6 +2502,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 				     struct mm_slot, mm_node);
 		mm_slot = mm_slot_entry(slot, struct khugepaged_mm_slot, slot);
 		khugepaged_scan.address = 0;
+		khugepaged_scan.nr_hot_collapsed = 0;
 		khugepaged_scan.mm_slot = mm_slot;
 	}
 	spin_unlock(&khugepaged_mm_lock);
@@ -2336,6 +2564,12 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 								   file, pgoff, cc);
 				mmap_locked = false;
 				fput(file);
+			} else if (READ_ONCE(khugepaged_hot_scan) &&
+				   !vma->vm_file) {
+				/* Collapsed by khugepaged_collapse_hot() */
+				khugepaged_rank_pmd(mm, vma,
+						    khugepaged_scan.address);
+				*result = SCAN_FAIL;
 			} else {
 				*result = hpage_collapse_scan_pmd(mm, vma,
 								  khugepaged_scan.address,
@@ -2381,6 +2615,8 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 breakouterloop:
 	mmap_read_unlock(mm); /* exit_mmap will destroy ptes after this */
 breakouterloop_mmap_lock:
+	if (khugepaged_scan.nr_hot)
+		khugepaged_collapse_hot(mm, result, cc);
 
 	spin_lock(&khugepaged_mm_lock);
 	VM_BUG_ON(khugepaged_scan.mm_slot != mm_slot);
@@ -2400,6 +2636,7 @@ static unsigned int khugepaged_scan_mm_slot(unsigned int pages, int *result,
 			khugepaged_scan.mm_slot =
 				mm_slot_entry(slot, struct khugepaged_mm_slot, slot);
 			khugepaged_scan.address = 0;
+			khugepaged_scan.nr_hot_collapsed = 0;
 		} else {
 			khugepaged_scan.mm_slot = NULL;
 			khugepaged_full_scans++;
@@ -39,6 +39,7 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -110,6 +111,11 @@
  *
  * If the merge_across_nodes tunable is unset, then KSM maintains multiple
  * stable trees and multiple unstable trees: one of each for each NUMA node.
+ *
+ * Each of those trees is further split into KSM_NR_SHARDS shards by the
+ * checksum of the page contents: identical pages always land in the same
+ * shard, and each shard only needs to be searched and updated by one scanner
+ * thread at a time, which lets ksmd spread its work over scan_threads.
  */
 
 /**
@@ -148,6 +154,7 @@ struct ksm_scan {
  * @kpfn: page frame number of this ksm page (perhaps temporarily on wrong nid)
  * @chain_prune_time: time of the last full garbage collection
  * @rmap_hlist_len: number of rmap_item entries in hlist or STABLE_NODE_CHAIN
+ * @shard: checksum shard of the stable tree in which linked
  * @nid: NUMA node id of stable tree in which linked (may not match kpfn)
  */
 struct ksm_stable_node {
@@ -173,6 +180,7 @@ struct ksm_stable_node {
 	 */
 #define STABLE_NODE_CHAIN -1024
 	int rmap_hlist_len;
+	unsigned int shard;
 #ifdef CONFIG_NUMA
 	int nid;
 #endif
@@ -214,12 +222,54 @@ struct ksm_rmap_item {
 #define UNSTABLE_FLAG	0x100	/* is a node of the unstable tree */
 #define STABLE_FLAG	0x200	/* is listed from the stable tree */
 
-/* The stable and unstable tree heads */
-static struct rb_root one_stable_tree[1] = { RB_ROOT };
-static struct rb_root one_unstable_tree[1] = { RB_ROOT };
+/* Maximum number of scanner threads, each owning at least one shard */
+#define KSM_MAX_THREADS	16
+/* Number of checksum shards of each stable and unstable tree */
+#define KSM_NR_SHARDS	KSM_MAX_THREADS
+/* Number of pages handed to the scanner threads at a time */
+#define KSM_SCAN_BATCH	256
+
+/**
+ * struct ksm_scan_item - a page picked up by the scanner
+ * @rmap_item: the reverse mapping of the virtual address being scanned
+ * @page: the page currently mapped there, with a reference held
+ * @checksum: checksum of the page contents, valid if @checksummed
+ * @checksummed: whether @checksum has been calculated yet
+ * @shard: the tree shard this page is searched and merged in
+ */
+struct ksm_scan_item {
+	struct ksm_rmap_item *rmap_item;
+	struct page *page;
+	unsigned int checksum;
+	bool checksummed;
+	unsigned int shard;
+};
+
+/* The stable and unstable tree heads, KSM_NR_SHARDS per NUMA node */
+static struct rb_root one_stable_tree[KSM_NR_SHARDS] = {
+	[0 ... KSM_NR_SHARDS - 1] = RB_ROOT
+};
+static struct rb_root one_unstable_tree[KSM_NR_SHARDS] = {
+	[0 ... KSM_NR_SHARDS - 1] = RB_ROOT
+};
 static struct rb_root *root_stable_tree = one_stable_tree;
 static struct rb_root *root_unstable_tree = one_unstable_tree;
 
+static inline unsigned int ksm_shard(unsigned int checksum)
+{
+	return checksum % KSM_NR_SHARDS;
+}
+
+static inline struct rb_root *stable_tree_root(int nid, unsigned int shard)
+{
+	return root_stable_tree + nid * KSM_NR_SHARDS + shard;
+}
+
+static inline struct rb_root *unstable_tree_root(int nid, unsigned int shard)
+{
+	return root_unstable_tree + nid * KSM_NR_SHARDS + shard;
+}
+
 /* Recently migrated nodes of stable tree, pending proper placement */
 static LIST_HEAD(migrate_nodes);
 #define STABLE_NODE_DUP_HEAD ((struct list_head *)&migrate_nodes.prev)
@@ -268,6 +318,9 @@ static unsigned int ksm_thread_pages_to_scan = 100;
 /* Milliseconds ksmd should sleep between batches */
 static unsigned int ksm_thread_sleep_millisecs = 20;
 
+/* Number of threads ksmd spreads its scan batch over */
+static unsigned int ksm_nr_threads = 1;
+
 /* Checksum of an empty (zeroed) page */
 static unsigned int zero_checksum __read_mostly;
 
@@ -295,6 +348,27 @@ static DECLARE_WAIT_QUEUE_HEAD(ksm_iter_wait);
 static DEFINE_MUTEX(ksm_thread_mutex);
 static DEFINE_SPINLOCK(ksm_mmlist_lock);
 
+/*
+ * With several scanner threads, ksm_thread_mutex is held by ksmd on behalf
+ * of all of them, and each tree shard is only touched by the thread owning
+ * it. What is shared between shards needs its own locks: the migrate_nodes
+ * list and the statistics below, including mm->ksm_merging_pages.
+ */
+static DEFINE_SPINLOCK(ksm_migrate_lock);
+static DEFINE_SPINLOCK(ksm_stat_lock);
+
+/* Helpers of ksmd when ksm_nr_threads > 1 */
+struct ksm_scan_worker {
+	struct work_struct work;
+	unsigned int id;
+};
+static struct workqueue_struct *ksm_scan_wq;
+static struct ksm_scan_worker ksm_scan_workers[KSM_MAX_THREADS];
+static struct ksm_scan_item ksm_scan_batch[KSM_SCAN_BATCH];
+static unsigned int ksm_scan_batch_size;
+static unsigned int ksm_scan_batch_threads;
+static bool ksm_scan_batch_merge;
+
 #define KSM_KMEM_CACHE(__struct, __flags) kmem_cache_create(#__struct,\
 		sizeof(struct __struct), __alignof__(struct __struct),\
 		(__flags), NULL)
@@ -348,14 +422,18 @@ static inline void stable_node_chain_add_dup(struct ksm_stable_node *dup,
 	dup->head = STABLE_NODE_DUP_HEAD;
 	VM_BUG_ON(!is_stable_node_chain(chain));
 	hlist_add_head(&dup->hlist_dup, &chain->hlist);
+	spin_lock(&ksm_stat_lock);
 	ksm_stable_node_dups++;
+	spin_unlock(&ksm_stat_lock);
 }
 
 static inline void __stable_node_dup_del(struct ksm_stable_node *dup)
 {
 	VM_BUG_ON(!is_stable_node_dup(dup));
 	hlist_del(&dup->hlist_dup);
+	spin_lock(&ksm_stat_lock);
 	ksm_stable_node_dups--;
+	spin_unlock(&ksm_stat_lock);
 }
 
 static inline void stable_node_dup_del(struct ksm_stable_node *dup)
@@ -364,12 +442,27 @@ static inline void stable_node_dup_del(struct ksm_stable_node *dup)
 	if (is_stable_node_dup(dup))
 		__stable_node_dup_del(dup);
 	else
-		rb_erase(&dup->node, root_stable_tree + NUMA(dup->nid));
+		rb_erase(&dup->node, stable_tree_root(NUMA(dup->nid), dup->shard));
 #ifdef CONFIG_DEBUG_VM
 	dup->head = NULL;
 #endif
 }
 
+static void migrate_nodes_add(struct ksm_stable_node *stable_node)
+{
+	stable_node->head = &migrate_nodes;
+	spin_lock(&ksm_migrate_lock);
+	list_add(&stable_node->list, stable_node->head);
+	spin_unlock(&ksm_migrate_lock);
+}
+
+static void migrate_nodes_del(struct ksm_stable_node *stable_node)
+{
+	spin_lock(&ksm_migrate_lock);
+	list_del(&stable_node->list);
+	spin_unlock(&ksm_migrate_lock);
+}
+
 static inline struct ksm_rmap_item *alloc_rmap_item(void)
 {
 	struct ksm_rmap_item *rmap_item;
@@ -565,10 +658,13 @@ static struct ksm_stable_node *alloc_stable_node_chain(struct ksm_stable_node *d
 		INIT_HLIST_HEAD(&chain->hlist);
 		chain->chain_prune_time = jiffies;
 		chain->rmap_hlist_len = STABLE_NODE_CHAIN;
+		chain->shard = dup->shard;
 #if defined (CONFIG_DEBUG_VM) && defined(CONFIG_NUMA)
 		chain->nid = NUMA_NO_NODE; /* debug */
 #endif
+		spin_lock(&ksm_stat_lock);
 		ksm_stable_node_chains++;
+		spin_unlock(&ksm_stat_lock);
 
 		/*
 		 * Put the stable node chain in the first dimension of
@@ -594,7 +690,9 @@ static inline void free_stable_node_chain(struct ksm_stable_node *chain,
 {
 	rb_erase(&chain->node, root);
 	free_stable_node(chain);
+	spin_lock(&ksm_stat_lock);
 	ksm_stable_node_chains--;
+	spin_unlock(&ksm_stat_lock);
 }
 
 static void remove_node_from_stable_tree(struct ksm_stable_node *stable_node)
@@ -605,12 +703,14 @@ static void remove_node_from_stable_tree(struct ksm_stable_node *stable_node)
 	BUG_ON(stable_node->rmap_hlist_len < 0);
 
 	hlist_for_each_entry(rmap_item, &stable_node->hlist, hlist) {
+		spin_lock(&ksm_stat_lock);
 		if (rmap_item->hlist.next)
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
 
 		rmap_item->mm->ksm_merging_pages--;
+		spin_unlock(&ksm_stat_lock);
 
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
@@ -630,7 +730,7 @@ static void remove_node_from_stable_tree(struct ksm_stable_node *stable_node)
 	BUILD_BUG_ON(STABLE_NODE_DUP_HEAD >= &migrate_nodes + 1);
 
 	if (stable_node->head == &migrate_nodes)
-		list_del(&stable_node->list);
+		migrate_nodes_del(stable_node);
 	else
 		stable_node_dup_del(stable_node);
 	free_stable_node(stable_node);
@@ -755,12 +855,14 @@ static void remove_rmap_item_from_tree(struct ksm_rmap_item *rmap_item)
 		unlock_page(page);
 		put_page(page);
 
+		spin_lock(&ksm_stat_lock);
 		if (!hlist_empty(&stable_node->hlist))
 			ksm_pages_sharing--;
 		else
 			ksm_pages_shared--;
 
 		rmap_item->mm->ksm_merging_pages--;
+		spin_unlock(&ksm_stat_lock);
 
 		VM_BUG_ON(stable_node->rmap_hlist_len <= 0);
 		stable_node->rmap_hlist_len--;
@@ -782,8 +884,11 @@ static void remove_rmap_item_from_tree(struct ksm_rmap_item *rmap_item)
 		BUG_ON(age > 1);
 		if (!age)
 			rb_erase(&rmap_item->node,
-				 root_unstable_tree + NUMA(rmap_item->nid));
+				 unstable_tree_root(NUMA(rmap_item->nid),
+						    ksm_shard(rmap_item->oldchecksum)));
+		spin_lock(&ksm_stat_lock);
 		ksm_pages_unshared--;
+		spin_unlock(&ksm_stat_lock);
 		rmap_item->address &= PAGE_MASK;
 	}
 out:
@@ -917,17 +1022,17 @@ static int remove_stable_node_chain(struct ksm_stable_node *stable_node,
 static int remove_all_stable_nodes(void)
 {
 	struct ksm_stable_node *stable_node, *next;
-	int nid;
+	int i;
 	int err = 0;
 
-	for (nid = 0; nid < ksm_nr_node_ids; nid++) {
-		while (root_stable_tree[nid].rb_node) {
-			stable_node = rb_entry(root_stable_tree[nid].rb_node,
+	for (i = 0; i < ksm_nr_node_ids * KSM_NR_SHARDS; i++) {
+		while (root_stable_tree[i].rb_node) {
+			stable_node = rb_entry(root_stable_tree[i].rb_node,
 						struct ksm_stable_node, node);
 			if (remove_stable_node_chain(stable_node,
-						     root_stable_tree + nid)) {
+						     root_stable_tree + i)) {
 				err = -EBUSY;
-				break;	/* proceed to next nid */
+				break;	/* proceed to next tree */
 			}
 			cond_resched();
 		}
@@ -1231,6 +1336,13 @@ static int try_to_merge_one_page(struct vm_area_struct *vma,
 	if (!trylock_page(page))
 		goto out;
 
+	/*
+	 * With several scanner threads, another one may have turned this
+	 * page into a ksm page of its own shard while we were not looking.
+	 */
+	if (!kpage && PageKsm(page))
+		goto out_unlock;
+
 	if (PageTransCompound(page)) {
 		if (split_huge_page(page))
 			goto out_unlock;
@@ -1429,8 +1541,10 @@ static struct page *stable_node_dup(struct ksm_stable_node **_stable_node_dup,
 			rb_replace_node(&stable_node->node, &found->node,
 					root);
 			free_stable_node(stable_node);
+			spin_lock(&ksm_stat_lock);
 			ksm_stable_node_chains--;
 			ksm_stable_node_dups--;
+			spin_unlock(&ksm_stat_lock);
 			/*
 			 * NOTE: the caller depends on the stable_node
 			 * to be equal to stable_node_dup if the chain
@@ -1549,7 +1663,7 @@ static __always_inline struct page *chain(struct ksm_stable_node **s_n_d,
  * This function returns the stable tree node of identical content if found,
  * NULL otherwise.
  */
-static struct page *stable_tree_search(struct page *page)
+static struct page *stable_tree_search(struct page *page, unsigned int shard)
 {
 	int nid;
 	struct rb_root *root;
@@ -1559,6 +1673,9 @@ static struct page *stable_tree_search(struct page *page)
 	struct ksm_stable_node *page_node;
 
 	page_node = page_stable_node(page);
+	/* Only another scanner thread may have made it a ksm page meanwhile */
+	if (page_node && page_node->shard != shard)
+		return ERR_PTR(-EBUSY);
 	if (page_node && page_node->head != &migrate_nodes) {
 		/* ksm page forked */
 		get_page(page);
@@ -1566,7 +1683,7 @@ static struct page *stable_tree_search(struct page *page)
 	}
 
 	nid = get_kpfn_nid(page_to_pfn(page));
-	root = root_stable_tree + nid;
+	root = stable_tree_root(nid, shard);
 again:
 	new = &root->rb_node;
 	parent = NULL;
@@ -1699,8 +1816,9 @@ static struct page *stable_tree_search(struct page *page)
 	if (!page_node)
 		return NULL;
 
-	list_del(&page_node->list);
+	migrate_nodes_del(page_node);
 	DO_NUMA(page_node->nid = nid);
+	page_node->shard = shard;
 	rb_link_node(&page_node->node, parent, new);
 	rb_insert_color(&page_node->node, root);
 out:
@@ -1725,8 +1843,9 @@ static struct page *stable_tree_search(struct page *page)
 		/* there is no chain */
 		if (page_node) {
 			VM_BUG_ON(page_node->head != &migrate_nodes);
-			list_del(&page_node->list);
+			migrate_nodes_del(page_node);
 			DO_NUMA(page_node->nid = nid);
+			page_node->shard = shard;
 			rb_replace_node(&stable_node_dup->node,
 					&page_node->node,
 					root);
@@ -1743,8 +1862,9 @@ static struct page *stable_tree_search(struct page *page)
 		__stable_node_dup_del(stable_node_dup);
 		if (page_node) {
 			VM_BUG_ON(page_node->head != &migrate_nodes);
-			list_del(&page_node->list);
+			migrate_nodes_del(page_node);
 			DO_NUMA(page_node->nid = nid);
+			page_node->shard = shard;
 			stable_node_chain_add_dup(page_node, stable_node);
 			if (is_page_sharing_candidate(page_node))
 				get_page(page);
@@ -1754,8 +1874,7 @@ static struct page *stable_tree_search(struct page *page)
 			page = NULL;
 		}
 	}
-	stable_node_dup->head = &migrate_nodes;
-	list_add(&stable_node_dup->list, stable_node_dup->head);
+	migrate_nodes_add(stable_node_dup);
 	return page;
 
 chain_append:
@@ -1786,8 +1905,9 @@ static struct page *stable_tree_search(struct page *page)
 	 */
 	VM_BUG_ON(!is_stable_node_dup(stable_node_dup));
 	VM_BUG_ON(page_node->head != &migrate_nodes);
-	list_del(&page_node->list);
+	migrate_nodes_del(page_node);
 	DO_NUMA(page_node->nid = nid);
+	page_node->shard = shard;
 	stable_node_chain_add_dup(page_node, stable_node);
 	goto out;
 }
@@ -1799,7 +1919,8 @@ static struct page *stable_tree_search(struct page *page)
  * This function returns the stable tree node just allocated on success,
  * NULL otherwise.
  */
-static struct ksm_stable_node *stable_tree_insert(struct page *kpage)
+static struct ksm_stable_node *stable_tree_insert(struct page *kpage,
+						  unsigned int shard)
 {
 	int nid;
 	unsigned long kpfn;
@@ -1811,7 +1932,7 @@ static struct ksm_stable_node *stable_tree_insert(struct page *kpage)
 
 	kpfn = page_to_pfn(kpage);
 	nid = get_kpfn_nid(kpfn);
-	root = root_stable_tree + nid;
+	root = stable_tree_root(nid, shard);
 again:
 	parent = NULL;
 	new = &root->rb_node;
@@ -1884,6 +2005,7 @@ static struct ksm_stable_node *stable_tree_insert(struct page *kpage)
 	stable_node_dup->kpfn = kpfn;
 	set_page_stable_node(kpage, stable_node_dup);
 	stable_node_dup->rmap_hlist_len = 0;
+	stable_node_dup->shard = shard;
 	DO_NUMA(stable_node_dup->nid = nid);
 	if (!need_chain) {
 		rb_link_node(&stable_node_dup->node, parent, new);
@@ -1929,7 +2051,7 @@ struct ksm_rmap_item *unstable_tree_search_insert(struct ksm_rmap_item *rmap_ite
 	int nid;
 
 	nid = get_kpfn_nid(page_to_pfn(page));
-	root = root_unstable_tree + nid;
+	root = unstable_tree_root(nid, ksm_shard(rmap_item->oldchecksum));
 	new = &root->rb_node;
 
 	while (*new) {
@@ -1981,7 +2103,9 @@ struct ksm_rmap_item *unstable_tree_search_insert(struct ksm_rmap_item *rmap_ite
 	rb_link_node(&rmap_item->node, parent, new);
 	rb_insert_color(&rmap_item->node, root);
 
+	spin_lock(&ksm_stat_lock);
 	ksm_pages_unshared++;
+	spin_unlock(&ksm_stat_lock);
 	return NULL;
 }
 
@@ -2016,12 +2140,14 @@ static void stable_tree_append(struct ksm_rmap_item *rmap_item,
 	rmap_item->address |= STABLE_FLAG;
 	hlist_add_head(&rmap_item->hlist, &stable_node->hlist);
 
+	spin_lock(&ksm_stat_lock);
 	if (rmap_item->hlist.next)
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
 
 	rmap_item->mm->ksm_merging_pages++;
+	spin_unlock(&ksm_stat_lock);
 }
 
 /*
@@ -2030,11 +2156,13 @@ static void stable_tree_append(struct ksm_rmap_item *rmap_item,
  * be inserted into the unstable tree, or merged with a page already there and
  * both transferred to the stable tree.
  *
- * @page: the page that we are searching identical page to.
- * @rmap_item: the reverse mapping into the virtual address of this page
+ * @item: the page that we are searching identical page to, its reverse
+ *	  mapping and the shard of the trees it belongs to
  */
-static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_item)
+static void cmp_and_merge_page(struct ksm_scan_item *item)
 {
+	struct page *page = item->page;
+	struct ksm_rmap_item *rmap_item = item->rmap_item;
 	struct mm_struct *mm = rmap_item->mm;
 	struct ksm_rmap_item *tree_rmap_item;
 	struct page *tree_page = NULL;
@@ -2046,12 +2174,14 @@ static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_ite
 
 	stable_node = page_stable_node(page);
 	if (stable_node) {
+		/* Became a ksm page of another shard since the item was prepared */
+		if (stable_node->shard != item->shard)
+			return;
 		if (stable_node->head != &migrate_nodes &&
 		    get_kpfn_nid(READ_ONCE(stable_node->kpfn)) !=
 		    NUMA(stable_node->nid)) {
 			stable_node_dup_del(stable_node);
-			stable_node->head = &migrate_nodes;
-			list_add(&stable_node->list, stable_node->head);
+			migrate_nodes_add(stable_node);
 		}
 		if (stable_node->head != &migrate_nodes &&
 		    rmap_item->head == stable_node)
@@ -2065,7 +2195,7 @@ static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_ite
 	}
 
 	/* We first start with searching the page inside the stable tree */
-	kpage = stable_tree_search(page);
+	kpage = stable_tree_search(page, item->shard);
 	if (kpage == page && rmap_item->head == stable_node) {
 		put_page(kpage);
 		return;
@@ -2098,12 +2228,23 @@ static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_ite
 	 * don't want to insert it in the unstable tree, and we don't want
 	 * to waste our time searching for something identical to it there.
 	 */
-	checksum = calc_checksum(page);
+	if (!item->checksummed) {
+		item->checksum = calc_checksum(page);
+		item->checksummed = true;
+	}
+	checksum = item->checksum;
 	if (rmap_item->oldchecksum != checksum) {
 		rmap_item->oldchecksum = checksum;
 		return;
 	}
 
+	/*
+	 * A ksm page of this shard that got unshared: its content now belongs
+	 * to an unstable tree this thread does not own. Try again next scan.
+	 */
+	if (ksm_shard(checksum) != item->shard)
+		return;
+
 	/*
 	 * Same checksum as an empty page. We attempt to merge it with the
 	 * appropriate zero page if the user enabled this via sysfs.
@@ -2157,7 +2298,7 @@ static void cmp_and_merge_page(struct page *page, struct ksm_rmap_item *rmap_ite
 			 * node in the stable tree and add both rmap_items.
 			 */
 			lock_page(kpage);
-			stable_node = stable_tree_insert(kpage);
+			stable_node = stable_tree_insert(kpage, item->shard);
 			if (stable_node) {
 				stable_tree_append(tree_rmap_item, stable_node,
 						   false);
@@ -2270,7 +2411,7 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 			}
 		}
 
-		for (nid = 0; nid < ksm_nr_node_ids; nid++)
+		for (nid = 0; nid < ksm_nr_node_ids * KSM_NR_SHARDS; nid++)
 			root_unstable_tree[nid] = RB_ROOT;
 
 		spin_lock(&ksm_mmlist_lock);
@@ -2392,22 +2533,160 @@ static struct ksm_rmap_item *scan_get_next_rmap_item(struct page **page)
 	return NULL;
 }
 
+/*
+ * Decide which shard of the trees a scanned page is looked up in: the shard
+ * of its stable node if it is a ksm page already, the one its content hashes
+ * to otherwise.
+ */
+static void ksm_prepare_scan_item(struct ksm_scan_item *item)
+{
+	struct ksm_stable_node *stable_node = page_stable_node(item->page);
+
+	if (stable_node) {
+		item->checksummed = false;
+		item->shard = stable_node->shard;
+	} else {
+		item->checksum = calc_checksum(item->page);
+		item->checksummed = true;
+		item->shard = ksm_shard(item->checksum);
+	}
+}
+
+/*
+ * An rmap_item still linked into a tree of another shard than the one its
+ * page is now looked up in must be unlinked before the threads start, as
+ * only the owner of a shard may modify it.
+ */
+static void ksm_unlink_foreign_item(struct ksm_scan_item *item)
+{
+	struct ksm_rmap_item *rmap_item = item->rmap_item;
+	unsigned int shard;
+
+	if (rmap_item->address & STABLE_FLAG)
+		shard = rmap_item->head->shard;
+	else if (rmap_item->address & UNSTABLE_FLAG)
+		shard = ksm_shard(rmap_item->oldchecksum);
+	else
+		return;
+
+	if (shard != item->shard)
+		remove_rmap_item_from_tree(rmap_item);
+}
+
+/*
+ * Each thread of a batch first prepares every nr-th item, then, once all
+ * items know their shard, merges the items of the shards it owns.
+ */
+static void ksm_scan_batch_run(unsigned int id)
+{
+	unsigned int nr = ksm_scan_batch_threads;
+	unsigned int i;
+
+	for (i = 0; i < ksm_scan_batch_size; i++) {
+		struct ksm_scan_item *item = &ksm_scan_batch[i];
+
+		if (!ksm_scan_batch_merge) {
+			if (i % nr == id)
+				ksm_prepare_scan_item(item);
+		} else if (item->shard % nr == id) {
+			cmp_and_merge_page(item);
+		}
+		cond_resched();
+	}
+}
+
+static void ksm_scan_worker_fn(struct work_struct *work)
+{
+	struct ksm_scan_worker *worker =
+		container_of(work, struct ksm_scan_worker, work);
+
+	ksm_scan_batch_run(worker->id);
+}
+
+static void ksm_scan_batch_step(bool merge)
+{
+	unsigned int id;
+
+	ksm_scan_batch_merge = merge;
+	for (id = 1; id < ksm_scan_batch_threads; id++)
+		queue_work(ksm_scan_wq, &ksm_scan_workers[id].work);
+	ksm_scan_batch_run(0);
+	for (id = 1; id < ksm_scan_batch_threads; id++)
+		flush_work(&ksm_scan_workers[id].work);
+}
+
+/*
+ * ksm_do_scan_parallel - scan like ksm_do_scan(), but spread the checksums
+ * and tree work of each batch of pages over ksm_nr_threads threads.
+ *
+ * Walking the mm list and the rmap_items stays with ksmd, as does anything
+ * that touches more than one shard. Every collected rmap_item pins its mm,
+ * so that __ksm_exit() cannot free it while the batch is in flight.
+ */
+static void ksm_do_scan_parallel(unsigned int scan_npages)
+{
+	struct ksm_rmap_item *rmap_item;
+	struct page *page;
+	unsigned int i, nr;
+	bool done = false;
+
+	while (!done && scan_npages && likely(!freezing(current))) {
+		nr = 0;
+		while (nr < KSM_SCAN_BATCH && scan_npages) {
+			cond_resched();
+			rmap_item = scan_get_next_rmap_item(&page);
+			if (!rmap_item) {
+				done = true;
+				break;
+			}
+			scan_npages--;
+			if (!mmget_not_zero(rmap_item->mm)) {
+				put_page(page);
+				continue;
+			}
+			ksm_scan_batch[nr].rmap_item = rmap_item;
+			ksm_scan_batch[nr].page = page;
+			nr++;
+		}
+		if (!nr)
+			break;
+
+		ksm_scan_batch_size = nr;
+		ksm_scan_batch_threads = min(ksm_nr_threads, nr);
+
+		ksm_scan_batch_step(false);
+		for (i = 0; i < nr; i++)
+			ksm_unlink_foreign_item(&ksm_scan_batch[i]);
+		ksm_scan_batch_step(true);
+
+		for (i = 0; i < nr; i++) {
+			put_page(ksm_scan_batch[i].page);
+			mmput_async(ksm_scan_batch[i].rmap_item->mm);
+		}
+	}
+}
+
 /**
  * ksm_do_scan  - the ksm scanner main worker function.
  * @scan_npages:  number of pages we want to scan before we return.
  */
 static void ksm_do_scan(unsigned int scan_npages)
 {
-	struct ksm_rmap_item *rmap_item;
-	struct page *page;
+	struct ksm_scan_item item;
+
+	if (ksm_nr_threads > 1) {
+		ksm_do_scan_parallel(scan_npages);
+		return;
+	}
 
 	while (scan_npages-- && likely(!freezing(current))) {
 		cond_resched();
-		rmap_item = scan_get_next_rmap_item(&page);
-		if (!rmap_item)
+		item.rmap_item = scan_get_next_rmap_item(&item.page);
+		if (!item.rmap_item)
 			return;
-		cmp_and_merge_page(page, rmap_item);
-		put_page(page);
+		ksm_prepare_scan_item(&item);
+		cmp_and_merge_page(&item);
+		put_page(item.page);
 	}
 }
 
@@ -2775,17 +3054,17 @@ static void ksm_check_stable_tree(unsigned long start_pfn,
 {
 	struct ksm_stable_node *stable_node, *next;
 	struct rb_node *node;
-	int nid;
+	int i;
 
-	for (nid = 0; nid < ksm_nr_node_ids; nid++) {
-		node = rb_first(root_stable_tree + nid);
+	for (i = 0; i < ksm_nr_node_ids * KSM_NR_SHARDS; i++) {
+		node = rb_first(root_stable_tree + i);
 		while (node) {
 			stable_node = rb_entry(node, struct ksm_stable_node, node);
 			if (stable_node_chain_remove_range(stable_node,
 							   start_pfn, end_pfn,
 							   root_stable_tree +
-							   nid))
-				node = rb_first(root_stable_tree + nid);
+							   i))
+				node = rb_first(root_stable_tree + i);
 			else
 				node = rb_next(node);
 			cond_resched();
@@ -2903,6 +3182,36 @@ static ssize_t pages_to_scan_store(struct kobject *kobj,
 }
 KSM_ATTR(pages_to_scan);
 
+static ssize_t scan_threads_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", ksm_nr_threads);
+}
+
+static ssize_t scan_threads_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned int nr_threads;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr_threads);
+	if (err)
+		return -EINVAL;
+	if (nr_threads < 1 || nr_threads > KSM_MAX_THREADS)
+		return -EINVAL;
+	if (nr_threads > 1 && !ksm_scan_wq)
+		return -ENOMEM;
+
+	/* Wait for ksmd to finish its current batch */
+	mutex_lock(&ksm_thread_mutex);
+	ksm_nr_threads = nr_threads;
+	mutex_unlock(&ksm_thread_mutex);
+
+	return count;
+}
+KSM_ATTR(scan_threads);
+
 static ssize_t run_show(struct kobject *kobj, struct kobj_attribute *attr,
 			char *buf)
 {
@@ -2982,19 +3291,21 @@ static ssize_t merge_across_nodes_store(struct kobject *kobj,
 			 * This is the first time that we switch away from the
 			 * default of merging across nodes: must now allocate
 			 * a buffer to hold as many roots as may be needed.
-			 * Allocate stable and unstable together:
-			 * MAXSMP NODES_SHIFT 10 will use 16kB.
+			 * Allocate stable and unstable together, with all
+			 * their shards: MAXSMP NODES_SHIFT 10 will use 256kB.
 			 */
-			buf = kcalloc(nr_node_ids + nr_node_ids, sizeof(*buf),
-				      GFP_KERNEL);
+			buf = kvcalloc(2 * nr_node_ids * KSM_NR_SHARDS,
+				       sizeof(*buf), GFP_KERNEL);
 			/* Let us assume that RB_ROOT is NULL is zero */
 			if (!buf)
 				err = -ENOMEM;
 			else {
 				root_stable_tree = buf;
-				root_unstable_tree = buf + nr_node_ids;
+				root_unstable_tree = buf +
+						     nr_node_ids * KSM_NR_SHARDS;
 				/* Stable tree is empty but not the unstable */
-				root_unstable_tree[0] = one_unstable_tree[0];
+				memcpy(root_unstable_tree, one_unstable_tree,
+				       sizeof(one_unstable_tree));
 			}
 		}
 		if (!err) {
@@ -3160,6 +3471,7 @@ KSM_ATTR_RO(full_scans);
 static struct attribute *ksm_attrs[] = {
 	&sleep_millisecs_attr.attr,
 	&pages_to_scan_attr.attr,
+	&scan_threads_attr.attr,
 	&run_attr.attr,
 	&pages_shared_attr.attr,
 	&pages_sharing_attr.attr,
@@ -3186,6 +3498,7 @@ static const struct attribute_group ksm_attr_group = {
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
+	unsigned int id;
 	int err;
 
 	/* The correct value depends on page size and endianness */
@@ -3197,6 +3510,13 @@ static int __init ksm_init(void)
 	if (err)
 		goto out;
 
+	/* Not fatal: ksmd then simply stays single threaded */
+	ksm_scan_wq = alloc_workqueue("ksm_scan", WQ_UNBOUND, 0);
+	for (id = 0; id < KSM_MAX_THREADS; id++) {
+		ksm_scan_workers[id].id = id;
+		INIT_WORK(&ksm_scan_workers[id].work, ksm_scan_worker_fn);
+	}
+
 	ksm_thread = kthread_run(ksm_scan_thread, NULL, "ksmd");
 	if (IS_ERR(ksm_thread)) {
 		pr_err("ksm: creating kthread failed\n");
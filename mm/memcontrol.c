@@ -73,6 +73,10 @@
 
 #include <trace/events/vmscan.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/memcg.h>
+#undef CREATE_TRACE_POINTS
+
 struct cgroup_subsys memory_cgrp_subsys __read_mostly;
 EXPORT_SYMBOL(memory_cgrp_subsys);
 
@@ -269,7 +273,7 @@ static void obj_cgroup_release(struct percpu_ref *ref)
 	 * However, it can be PAGE_SIZE or (x * PAGE_SIZE).
 	 *
 	 * The following sequence can lead to it:
-	 * 1) CPU0: objcg == stock->cached_objcg
+	 * 1) CPU0: objcg is cached in one of stock->obj_slots
 	 * 2) CPU1: we do a small allocation (e.g. 92 bytes),
 	 *          PAGE_SIZE bytes are charged
 	 * 3) CPU1: a process from another memcg is allocating something,
@@ -575,18 +579,22 @@ mem_cgroup_largest_soft_limit_node(struct mem_cgroup_tree_per_node *mctz)
  *    rstat update tree grow unbounded.
  *
  * 2) Flush the stats synchronously on reader side only when there are more than
- *    (MEMCG_CHARGE_BATCH * nr_cpus) update events. Though this optimization
- *    will let stats be out of sync by atmost (MEMCG_CHARGE_BATCH * nr_cpus) but
- *    only for 2 seconds due to (1).
+ *    (MEMCG_CHARGE_BATCH * nr_cpus) update events in the subtree being read,
+ *    and flush only that subtree. Though this optimization will let stats be
+ *    out of sync by atmost (MEMCG_CHARGE_BATCH * nr_cpus) but only for 2
+ *    seconds due to (1).
+ *
+ * 3) Bound the time readers spend flushing: a subtree whose last synchronous
+ *    flush took longer than FLUSH_LATENCY_MAX is flushed synchronously at
+ *    most once per FLUSH_TIME, and is otherwise served by (1).
  */
 static void flush_memcg_stats_dwork(struct work_struct *w);
 static DECLARE_DEFERRABLE_WORK(stats_flush_dwork, flush_memcg_stats_dwork);
 static DEFINE_SPINLOCK(stats_flush_lock);
-static DEFINE_PER_CPU(unsigned int, stats_updates);
-static atomic_t stats_flush_threshold = ATOMIC_INIT(0);
 static u64 flush_next_time;
 
 #define FLUSH_TIME (2UL*HZ)
+#define FLUSH_LATENCY_MAX NSEC_PER_MSEC
 
 /*
  * Accessors to ensure that preemption is disabled on PREEMPT_RT because it can
@@ -610,57 +618,6 @@ static void memcg_stats_unlock(void)
 	preempt_enable_nested();
 }
 
-static inline void memcg_rstat_updated(struct mem_cgroup *memcg, int val)
-{
-	unsigned int x;
-
-	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
-
-	x = __this_cpu_add_return(stats_updates, abs(val));
-	if (x > MEMCG_CHARGE_BATCH) {
-		/*
-		 * If stats_flush_threshold exceeds the threshold
-		 * (>num_online_cpus()), cgroup stats update will be triggered
-		 * in __mem_cgroup_flush_stats(). Increasing this var further
-		 * is redundant and simply adds overhead in atomic update.
-		 */
-		if (atomic_read(&stats_flush_threshold) <= num_online_cpus())
-			atomic_add(x / MEMCG_CHARGE_BATCH, &stats_flush_threshold);
-		__this_cpu_write(stats_updates, 0);
-	}
-}
-
-static void __mem_cgroup_flush_stats(void)
-{
-	unsigned long flag;
-
-	if (!spin_trylock_irqsave(&stats_flush_lock, flag))
-		return;
-
-	flush_next_time = jiffies_64 + 2*FLUSH_TIME;
-	cgroup_rstat_flush_irqsafe(root_mem_cgroup->css.cgroup);
-	atomic_set(&stats_flush_threshold, 0);
-	spin_unlock_irqrestore(&stats_flush_lock, flag);
-}
-
-void mem_cgroup_flush_stats(void)
-{
-	if (atomic_read(&stats_flush_threshold) > num_online_cpus())
-		__mem_cgroup_flush_stats();
-}
-
-void mem_cgroup_flush_stats_delayed(void)
-{
-	if (time_after64(jiffies_64, flush_next_time))
-		mem_cgroup_flush_stats();
-}
-
-static void flush_memcg_stats_dwork(struct work_struct *w)
-{
-	__mem_cgroup_flush_stats();
-	queue_delayed_work(system_unbound_wq, &stats_flush_dwork, FLUSH_TIME);
-}
-
 /* Subset of vm_event_item to report for memcg event stats */
 static const unsigned int memcg_vm_event_stat[] = {
 	PGPGIN,
@@ -714,6 +671,9 @@ struct memcg_vmstats_percpu {
 	/* Cgroup1: threshold notifications & softlimit tree updates */
 	unsigned long		nr_page_events;
 	unsigned long		targets[MEM_CGROUP_NTARGETS];
+
+	/* Stats updates since the last flush, not yet in vmstats */
+	unsigned int		stats_updates;
 };
 
 struct memcg_vmstats {
@@ -724,8 +684,125 @@ struct memcg_vmstats {
 	/* Pending child counts during tree propagation */
 	long			state_pending[MEMCG_NR_STAT];
 	unsigned long		events_pending[NR_MEMCG_EVENTS];
+
+	/* Stats updates in the subtree since the last flush */
+	atomic64_t		stats_updates;
+
+	/* Duration and time of the last synchronous flush */
+	u64			flush_ns;
+	u64			flush_time;
 };
 
+static bool memcg_vmstats_needs_flush(struct memcg_vmstats *vmstats)
+{
+	return atomic64_read(&vmstats->stats_updates) >
+		MEMCG_CHARGE_BATCH * num_online_cpus();
+}
+
+static inline void memcg_rstat_updated(struct mem_cgroup *memcg, int val)
+{
+	struct memcg_vmstats_percpu *statc;
+	unsigned int stats_updates;
+
+	cgroup_rstat_updated(memcg->css.cgroup, smp_processor_id());
+
+	/*
+	 * Account the update to every level up to the root, so that readers
+	 * can tell whether their own subtree needs a flush.  Only the per-CPU
+	 * counters are touched until a CPU has accumulated a batch.
+	 */
+	for (; memcg; memcg = parent_mem_cgroup(memcg)) {
+		statc = this_cpu_ptr(memcg->vmstats_percpu);
+		stats_updates = READ_ONCE(statc->stats_updates) + abs(val);
+		WRITE_ONCE(statc->stats_updates, stats_updates);
+		if (stats_updates < MEMCG_CHARGE_BATCH)
+			continue;
+
+		/*
+		 * If the subtree is already over the flush threshold, adding
+		 * more is redundant and simply adds overhead in atomic update.
+		 */
+		if (!memcg_vmstats_needs_flush(memcg->vmstats))
+			atomic64_add(stats_updates,
+				     &memcg->vmstats->stats_updates);
+		WRITE_ONCE(statc->stats_updates, 0);
+	}
+}
+
+static void do_flush_stats(struct mem_cgroup *memcg)
+{
+	struct memcg_vmstats *vmstats = memcg->vmstats;
+	bool root = mem_cgroup_is_root(memcg);
+	unsigned long flag;
+	s64 stats_updates;
+	u64 start, duration;
+
+	/* A root flush covers everybody else: don't pile up behind one */
+	if (root) {
+		if (!spin_trylock_irqsave(&stats_flush_lock, flag))
+			return;
+		flush_next_time = jiffies_64 + 2*FLUSH_TIME;
+	}
+
+	stats_updates = atomic64_read(&vmstats->stats_updates);
+	start = ktime_get_ns();
+	cgroup_rstat_flush_irqsafe(memcg->css.cgroup);
+	duration = ktime_get_ns() - start;
+
+	WRITE_ONCE(vmstats->flush_ns, duration);
+	WRITE_ONCE(vmstats->flush_time, jiffies_64);
+	trace_memcg_flush_stats(memcg, stats_updates, duration);
+
+	if (root)
+		spin_unlock_irqrestore(&stats_flush_lock, flag);
+}
+
+/**
+ * mem_cgroup_flush_stats - flush the stats of a memory cgroup subtree
+ * @memcg: root of the subtree to flush, or NULL for the whole hierarchy
+ *
+ * Flushing is skipped while fewer than MEMCG_CHARGE_BATCH * nr_cpus updates
+ * are pending in the subtree, and rate limited for subtrees whose flushes
+ * take longer than FLUSH_LATENCY_MAX: the periodic flush keeps their stats
+ * within FLUSH_TIME.
+ */
+void mem_cgroup_flush_stats(struct mem_cgroup *memcg)
+{
+	struct memcg_vmstats *vmstats;
+
+	if (mem_cgroup_disabled())
+		return;
+
+	if (!memcg)
+		memcg = root_mem_cgroup;
+	vmstats = memcg->vmstats;
+
+	if (!memcg_vmstats_needs_flush(vmstats))
+		return;
+
+	if (READ_ONCE(vmstats->flush_ns) > FLUSH_LATENCY_MAX &&
+	    time_before64(jiffies_64, READ_ONCE(vmstats->flush_time) + FLUSH_TIME))
+		return;
+
+	do_flush_stats(memcg);
+}
+
+void mem_cgroup_flush_stats_delayed(struct mem_cgroup *memcg)
+{
+	if (time_after64(jiffies_64, flush_next_time))
+		mem_cgroup_flush_stats(memcg);
+}
+
+static void flush_memcg_stats_dwork(struct work_struct *w)
+{
+	/*
+	 * Deliberately ignore memcg_vmstats_needs_flush() here, so that the
+	 * rstat update tree cannot grow unbounded between reads.
+	 */
+	do_flush_stats(root_mem_cgroup);
+	queue_delayed_work(system_unbound_wq, &stats_flush_dwork, FLUSH_TIME);
+}
+
 unsigned long memcg_page_state(struct mem_cgroup *memcg, int idx)
 {
 	long x = READ_ONCE(memcg->vmstats->state[idx]);
@@ -1562,7 +1639,7 @@ static void memory_stat_format(struct mem_cgroup *memcg, char *buf, int bufsize)
 	 *
 	 * Current memory state:
 	 */
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		u64 size;
@@ -2172,18 +2249,39 @@ void unlock_page_memcg(struct page *page)
 	folio_memcg_unlock(page_folio(page));
 }
 
-struct memcg_stock_pcp {
-	local_lock_t stock_lock;
+/*
+ * Number of memcgs (and objcgs) whose charges a CPU keeps cached at once.
+ * With several containers sharing a CPU, a single slot gets drained on
+ * nearly every charge and each charge goes back to the page counters.
+ */
+#define NR_MEMCG_STOCK		4
+
+struct memcg_stock_slot {
 	struct mem_cgroup *cached; /* this never be root cgroup */
 	unsigned int nr_pages;
+	unsigned int last_used;
+};
 
 #ifdef CONFIG_MEMCG_KMEM
+struct obj_stock_slot {
 	struct obj_cgroup *cached_objcg;
 	struct pglist_data *cached_pgdat;
 	unsigned int nr_bytes;
 	int nr_slab_reclaimable_b;
 	int nr_slab_unreclaimable_b;
+	unsigned int last_used;
+};
+#endif
+
+struct memcg_stock_pcp {
+	local_lock_t stock_lock;
+	struct memcg_stock_slot slots[NR_MEMCG_STOCK];
+
+#ifdef CONFIG_MEMCG_KMEM
+	struct obj_stock_slot obj_slots[NR_MEMCG_STOCK];
 #endif
+	/* Ticks on every use of a slot, for LRU replacement */
+	unsigned int clock;
 
 	struct work_struct work;
 	unsigned long flags;
@@ -2195,15 +2293,16 @@ static DEFINE_PER_CPU(struct memcg_stock_pcp, memcg_stock) = {
 static DEFINE_MUTEX(percpu_charge_mutex);
 
 #ifdef CONFIG_MEMCG_KMEM
-static struct obj_cgroup *drain_obj_stock(struct memcg_stock_pcp *stock);
+static void drain_obj_stocks(struct memcg_stock_pcp *stock,
+			     struct obj_cgroup **old);
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 				     struct mem_cgroup *root_memcg);
 static void memcg_account_kmem(struct mem_cgroup *memcg, int nr_pages);
 
 #else
-static inline struct obj_cgroup *drain_obj_stock(struct memcg_stock_pcp *stock)
+static inline void drain_obj_stocks(struct memcg_stock_pcp *stock,
+				    struct obj_cgroup **old)
 {
-	return NULL;
 }
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 				     struct mem_cgroup *root_memcg)
@@ -2215,20 +2314,52 @@ static void memcg_account_kmem(struct mem_cgroup *memcg, int nr_pages)
 }
 #endif
 
+static struct memcg_stock_slot *memcg_stock_find(struct memcg_stock_pcp *stock,
+						 struct mem_cgroup *memcg)
+{
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		if (stock->slots[i].cached == memcg)
+			return &stock->slots[i];
+	return NULL;
+}
+
+/*
+ * Returns a free slot, or the least recently used one.
+ */
+static struct memcg_stock_slot *memcg_stock_victim(struct memcg_stock_pcp *stock)
+{
+	struct memcg_stock_slot *victim = &stock->slots[0];
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++) {
+		struct memcg_stock_slot *slot = &stock->slots[i];
+
+		if (!slot->cached)
+			return slot;
+		if (stock->clock - slot->last_used >
+		    stock->clock - victim->last_used)
+			victim = slot;
+	}
+	return victim;
+}
+
 /**
  * consume_stock: Try to consume stocked charge on this cpu.
  * @memcg: memcg to consume from.
  * @nr_pages: how many pages to charge.
  *
- * The charges will only happen if @memcg matches the current cpu's memcg
- * stock, and at least @nr_pages are available in that stock.  Failure to
- * service an allocation will refill the stock.
+ * The charges will only happen if @memcg is cached in one of the current
+ * cpu's stock slots, and at least @nr_pages are available in that slot.
+ * Failure to service an allocation will refill the stock.
  *
  * returns true if successful, false otherwise.
  */
 static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
 	struct memcg_stock_pcp *stock;
+	struct memcg_stock_slot *slot;
 	unsigned long flags;
 	bool ret = false;
 
@@ -2238,8 +2369,10 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	local_lock_irqsave(&memcg_stock.stock_lock, flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (memcg == stock->cached && stock->nr_pages >= nr_pages) {
-		stock->nr_pages -= nr_pages;
+	slot = memcg_stock_find(stock, memcg);
+	if (slot && slot->nr_pages >= nr_pages) {
+		slot->nr_pages -= nr_pages;
+		slot->last_used = ++stock->clock;
 		ret = true;
 	}
 
@@ -2249,31 +2382,43 @@ static bool consume_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 }
 
 /*
- * Returns stocks cached in percpu and reset cached information.
+ * Returns the charges cached in a slot and resets it.
  */
-static void drain_stock(struct memcg_stock_pcp *stock)
+static void drain_stock_slot(struct memcg_stock_slot *slot)
 {
-	struct mem_cgroup *old = stock->cached;
+	struct mem_cgroup *old = slot->cached;
 
 	if (!old)
 		return;
 
-	if (stock->nr_pages) {
-		page_counter_uncharge(&old->memory, stock->nr_pages);
+	if (slot->nr_pages) {
+		page_counter_uncharge(&old->memory, slot->nr_pages);
 		if (do_memsw_account())
-			page_counter_uncharge(&old->memsw, stock->nr_pages);
-		stock->nr_pages = 0;
+			page_counter_uncharge(&old->memsw, slot->nr_pages);
+		slot->nr_pages = 0;
 	}
 
 	css_put(&old->css);
-	stock->cached = NULL;
+	WRITE_ONCE(slot->cached, NULL);
+}
+
+/*
+ * Returns stocks cached in percpu and reset cached information.
+ */
+static void drain_stock(struct memcg_stock_pcp *stock)
+{
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		drain_stock_slot(&stock->slots[i]);
 }
 
 static void drain_local_stock(struct work_struct *dummy)
 {
+	struct obj_cgroup *old[NR_MEMCG_STOCK] = { };
 	struct memcg_stock_pcp *stock;
-	struct obj_cgroup *old = NULL;
 	unsigned long flags;
+	int i;
 
 	/*
 	 * The only protection from cpu hotplug (memcg_hotplug_cpu_dead) vs.
@@ -2283,13 +2428,14 @@ static void drain_local_stock(struct work_struct *dummy)
 	local_lock_irqsave(&memcg_stock.stock_lock, flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	old = drain_obj_stock(stock);
+	drain_obj_stocks(stock, old);
 	drain_stock(stock);
 	clear_bit(FLUSHING_CACHED_CHARGE, &stock->flags);
 
 	local_unlock_irqrestore(&memcg_stock.stock_lock, flags);
-	if (old)
-		obj_cgroup_put(old);
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		if (old[i])
+			obj_cgroup_put(old[i]);
 }
 
 /*
@@ -2299,17 +2445,21 @@ static void drain_local_stock(struct work_struct *dummy)
 static void __refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 {
 	struct memcg_stock_pcp *stock;
+	struct memcg_stock_slot *slot;
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (stock->cached != memcg) { /* reset if necessary */
-		drain_stock(stock);
+	slot = memcg_stock_find(stock, memcg);
+	if (!slot) { /* reuse the least recently used slot */
+		slot = memcg_stock_victim(stock);
+		drain_stock_slot(slot);
 		css_get(&memcg->css);
-		stock->cached = memcg;
+		WRITE_ONCE(slot->cached, memcg);
 	}
-	stock->nr_pages += nr_pages;
+	slot->last_used = ++stock->clock;
+	slot->nr_pages += nr_pages;
 
-	if (stock->nr_pages > MEMCG_CHARGE_BATCH)
-		drain_stock(stock);
+	if (slot->nr_pages > MEMCG_CHARGE_BATCH)
+		drain_stock_slot(slot);
 }
 
 static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
@@ -2321,9 +2471,27 @@ static void refill_stock(struct mem_cgroup *memcg, unsigned int nr_pages)
 	local_unlock_irqrestore(&memcg_stock.stock_lock, flags);
 }
 
+static bool memcg_stock_flush_required(struct memcg_stock_pcp *stock,
+				       struct mem_cgroup *root_memcg)
+{
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++) {
+		struct memcg_stock_slot *slot = &stock->slots[i];
+		struct mem_cgroup *memcg = READ_ONCE(slot->cached);
+
+		if (memcg && READ_ONCE(slot->nr_pages) &&
+		    mem_cgroup_is_descendant(memcg, root_memcg))
+			return true;
+	}
+
+	return false;
+}
+
 /*
  * Drains all per-CPU charge caches for given root_memcg resp. subtree
- * of the hierarchy under it.
+ * of the hierarchy under it.  A CPU caching charges for any memcg in the
+ * subtree has all of its slots drained.
  */
 static void drain_all_stock(struct mem_cgroup *root_memcg)
 {
@@ -2342,16 +2510,11 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 	curcpu = smp_processor_id();
 	for_each_online_cpu(cpu) {
 		struct memcg_stock_pcp *stock = &per_cpu(memcg_stock, cpu);
-		struct mem_cgroup *memcg;
-		bool flush = false;
+		bool flush;
 
 		rcu_read_lock();
-		memcg = stock->cached;
-		if (memcg && stock->nr_pages &&
-		    mem_cgroup_is_descendant(memcg, root_memcg))
-			flush = true;
-		else if (obj_stock_flush_required(stock, root_memcg))
-			flush = true;
+		flush = memcg_stock_flush_required(stock, root_memcg) ||
+			obj_stock_flush_required(stock, root_memcg);
 		rcu_read_unlock();
 
 		if (flush &&
@@ -2368,11 +2531,24 @@ static void drain_all_stock(struct mem_cgroup *root_memcg)
 
 static int memcg_hotplug_cpu_dead(unsigned int cpu)
 {
+	struct obj_cgroup *old[NR_MEMCG_STOCK] = { };
 	struct memcg_stock_pcp *stock;
+	unsigned long flags;
+	int i;
 
 	stock = &per_cpu(memcg_stock, cpu);
+
+	/* drain_obj_stocks() refills the local stock, it needs stock_lock */
+	local_lock_irqsave(&memcg_stock.stock_lock, flags);
+	drain_obj_stocks(stock, old);
+	local_unlock_irqrestore(&memcg_stock.stock_lock, flags);
+
 	drain_stock(stock);
 
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		if (old[i])
+			obj_cgroup_put(old[i]);
+
 	return 0;
 }
 
@@ -3156,10 +3332,68 @@ void __memcg_kmem_uncharge_page(struct page *page, int order)
 	obj_cgroup_put(objcg);
 }
 
+static struct obj_stock_slot *obj_stock_find(struct memcg_stock_pcp *stock,
+					     struct obj_cgroup *objcg)
+{
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		if (READ_ONCE(stock->obj_slots[i].cached_objcg) == objcg)
+			return &stock->obj_slots[i];
+	return NULL;
+}
+
+/*
+ * Returns a free slot, or the least recently used one.
+ */
+static struct obj_stock_slot *obj_stock_victim(struct memcg_stock_pcp *stock)
+{
+	struct obj_stock_slot *victim = &stock->obj_slots[0];
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++) {
+		struct obj_stock_slot *slot = &stock->obj_slots[i];
+
+		if (!slot->cached_objcg)
+			return slot;
+		if (stock->clock - slot->last_used >
+		    stock->clock - victim->last_used)
+			victim = slot;
+	}
+	return victim;
+}
+
+static struct obj_cgroup *drain_obj_stock(struct obj_stock_slot *slot);
+
+/*
+ * Returns the slot caching @objcg, taking over the least recently used
+ * slot if there is none.  The objcg previously cached there, if any, is
+ * returned in @old and must be put outside of the stock lock.
+ */
+static struct obj_stock_slot *obj_stock_get_slot(struct memcg_stock_pcp *stock,
+						 struct obj_cgroup *objcg,
+						 struct obj_cgroup **old)
+{
+	struct obj_stock_slot *slot = obj_stock_find(stock, objcg);
+
+	if (!slot) {
+		slot = obj_stock_victim(stock);
+		*old = drain_obj_stock(slot);
+		obj_cgroup_get(objcg);
+		slot->nr_bytes = atomic_read(&objcg->nr_charged_bytes)
+				? atomic_xchg(&objcg->nr_charged_bytes, 0) : 0;
+		WRITE_ONCE(slot->cached_objcg, objcg);
+	}
+	slot->last_used = ++stock->clock;
+
+	return slot;
+}
+
 void mod_objcg_state(struct obj_cgroup *objcg, struct pglist_data *pgdat,
 		     enum node_stat_item idx, int nr)
 {
 	struct memcg_stock_pcp *stock;
+	struct obj_stock_slot *slot;
 	struct obj_cgroup *old = NULL;
 	unsigned long flags;
 	int *bytes;
@@ -3172,32 +3406,28 @@ void mod_objcg_state(struct obj_cgroup *objcg, struct pglist_data *pgdat,
 	 * accumulating over a page of vmstat data or when pgdat or idx
 	 * changes.
 	 */
-	if (READ_ONCE(stock->cached_objcg) != objcg) {
-		old = drain_obj_stock(stock);
-		obj_cgroup_get(objcg);
-		stock->nr_bytes = atomic_read(&objcg->nr_charged_bytes)
-				? atomic_xchg(&objcg->nr_charged_bytes, 0) : 0;
-		WRITE_ONCE(stock->cached_objcg, objcg);
-		stock->cached_pgdat = pgdat;
-	} else if (stock->cached_pgdat != pgdat) {
+	slot = obj_stock_get_slot(stock, objcg, &old);
+	if (!slot->cached_pgdat) {
+		slot->cached_pgdat = pgdat;
+	} else if (slot->cached_pgdat != pgdat) {
 		/* Flush the existing cached vmstat data */
-		struct pglist_data *oldpg = stock->cached_pgdat;
+		struct pglist_data *oldpg = slot->cached_pgdat;
 
-		if (stock->nr_slab_reclaimable_b) {
+		if (slot->nr_slab_reclaimable_b) {
 			mod_objcg_mlstate(objcg, oldpg, NR_SLAB_RECLAIMABLE_B,
-					  stock->nr_slab_reclaimable_b);
-			stock->nr_slab_reclaimable_b = 0;
+					  slot->nr_slab_reclaimable_b);
+			slot->nr_slab_reclaimable_b = 0;
 		}
-		if (stock->nr_slab_unreclaimable_b) {
+		if (slot->nr_slab_unreclaimable_b) {
 			mod_objcg_mlstate(objcg, oldpg, NR_SLAB_UNRECLAIMABLE_B,
-					  stock->nr_slab_unreclaimable_b);
-			stock->nr_slab_unreclaimable_b = 0;
+					  slot->nr_slab_unreclaimable_b);
+			slot->nr_slab_unreclaimable_b = 0;
 		}
-		stock->cached_pgdat = pgdat;
+		slot->cached_pgdat = pgdat;
 	}
 
-	bytes = (idx == NR_SLAB_RECLAIMABLE_B) ? &stock->nr_slab_reclaimable_b
-					       : &stock->nr_slab_unreclaimable_b;
+	bytes = (idx == NR_SLAB_RECLAIMABLE_B) ? &slot->nr_slab_reclaimable_b
+					       : &slot->nr_slab_unreclaimable_b;
 	/*
 	 * Even for large object >= PAGE_SIZE, the vmstat data will still be
 	 * cached locally at least once before pushing it out.
@@ -3225,14 +3455,17 @@ void mod_objcg_state(struct obj_cgroup *objcg, struct pglist_data *pgdat,
 static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
 {
 	struct memcg_stock_pcp *stock;
+	struct obj_stock_slot *slot;
 	unsigned long flags;
 	bool ret = false;
 
 	local_lock_irqsave(&memcg_stock.stock_lock, flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (objcg == READ_ONCE(stock->cached_objcg) && stock->nr_bytes >= nr_bytes) {
-		stock->nr_bytes -= nr_bytes;
+	slot = obj_stock_find(stock, objcg);
+	if (slot && slot->nr_bytes >= nr_bytes) {
+		slot->nr_bytes -= nr_bytes;
+		slot->last_used = ++stock->clock;
 		ret = true;
 	}
 
@@ -3241,16 +3474,16 @@ static bool consume_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes)
 	return ret;
 }
 
-static struct obj_cgroup *drain_obj_stock(struct memcg_stock_pcp *stock)
+static struct obj_cgroup *drain_obj_stock(struct obj_stock_slot *slot)
 {
-	struct obj_cgroup *old = READ_ONCE(stock->cached_objcg);
+	struct obj_cgroup *old = READ_ONCE(slot->cached_objcg);
 
 	if (!old)
 		return NULL;
 
-	if (stock->nr_bytes) {
-		unsigned int nr_pages = stock->nr_bytes >> PAGE_SHIFT;
-		unsigned int nr_bytes = stock->nr_bytes & (PAGE_SIZE - 1);
+	if (slot->nr_bytes) {
+		unsigned int nr_pages = slot->nr_bytes >> PAGE_SHIFT;
+		unsigned int nr_bytes = slot->nr_bytes & (PAGE_SIZE - 1);
 
 		if (nr_pages) {
 			struct mem_cgroup *memcg;
@@ -3274,29 +3507,29 @@ static struct obj_cgroup *drain_obj_stock(struct memcg_stock_pcp *stock)
 		 * so it might be changed in the future.
 		 */
 		atomic_add(nr_bytes, &old->nr_charged_bytes);
-		stock->nr_bytes = 0;
+		slot->nr_bytes = 0;
 	}
 
 	/*
 	 * Flush the vmstat data in current stock
 	 */
-	if (stock->nr_slab_reclaimable_b || stock->nr_slab_unreclaimable_b) {
-		if (stock->nr_slab_reclaimable_b) {
-			mod_objcg_mlstate(old, stock->cached_pgdat,
+	if (slot->nr_slab_reclaimable_b || slot->nr_slab_unreclaimable_b) {
+		if (slot->nr_slab_reclaimable_b) {
+			mod_objcg_mlstate(old, slot->cached_pgdat,
 					  NR_SLAB_RECLAIMABLE_B,
-					  stock->nr_slab_reclaimable_b);
-			stock->nr_slab_reclaimable_b = 0;
+					  slot->nr_slab_reclaimable_b);
+			slot->nr_slab_reclaimable_b = 0;
 		}
-		if (stock->nr_slab_unreclaimable_b) {
-			mod_objcg_mlstate(old, stock->cached_pgdat,
+		if (slot->nr_slab_unreclaimable_b) {
+			mod_objcg_mlstate(old, slot->cached_pgdat,
 					  NR_SLAB_UNRECLAIMABLE_B,
-					  stock->nr_slab_unreclaimable_b);
-			stock->nr_slab_unreclaimable_b = 0;
+					  slot->nr_slab_unreclaimable_b);
+			slot->nr_slab_unreclaimable_b = 0;
 		}
-		stock->cached_pgdat = NULL;
 	}
+	slot->cached_pgdat = NULL;
 
-	WRITE_ONCE(stock->cached_objcg, NULL);
+	WRITE_ONCE(slot->cached_objcg, NULL);
 	/*
 	 * The `old' objects needs to be released by the caller via
 	 * obj_cgroup_put() outside of memcg_stock_pcp::stock_lock.
@@ -3304,13 +3537,31 @@ static struct obj_cgroup *drain_obj_stock(struct memcg_stock_pcp *stock)
 	return old;
 }
 
+/*
+ * Drains every obj stock slot.  The objcgs they cached are returned in
+ * @old, one per slot, to be put outside of the stock lock.
+ */
+static void drain_obj_stocks(struct memcg_stock_pcp *stock,
+			     struct obj_cgroup **old)
+{
+	int i;
+
+	for (i = 0; i < NR_MEMCG_STOCK; i++)
+		old[i] = drain_obj_stock(&stock->obj_slots[i]);
+}
+
 static bool obj_stock_flush_required(struct memcg_stock_pcp *stock,
 				     struct mem_cgroup *root_memcg)
 {
-	struct obj_cgroup *objcg = READ_ONCE(stock->cached_objcg);
 	struct mem_cgroup *memcg;
+	int i;
 
-	if (objcg) {
+	for (i = 0; i < NR_MEMCG_STOCK; i++) {
+		struct obj_cgroup *objcg;
+
+		objcg = READ_ONCE(stock->obj_slots[i].cached_objcg);
+		if (!objcg)
+			continue;
 		memcg = obj_cgroup_memcg(objcg);
 		if (memcg && mem_cgroup_is_descendant(memcg, root_memcg))
 			return true;
@@ -3323,6 +3574,7 @@ static void refill_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes,
 			     bool allow_uncharge)
 {
 	struct memcg_stock_pcp *stock;
+	struct obj_stock_slot *slot;
 	struct obj_cgroup *old = NULL;
 	unsigned long flags;
 	unsigned int nr_pages = 0;
@@ -3330,19 +3582,18 @@ static void refill_obj_stock(struct obj_cgroup *objcg, unsigned int nr_bytes,
 	local_lock_irqsave(&memcg_stock.stock_lock, flags);
 
 	stock = this_cpu_ptr(&memcg_stock);
-	if (READ_ONCE(stock->cached_objcg) != objcg) { /* reset if necessary */
-		old = drain_obj_stock(stock);
-		obj_cgroup_get(objcg);
-		WRITE_ONCE(stock->cached_objcg, objcg);
-		stock->nr_bytes = atomic_read(&objcg->nr_charged_bytes)
-				? atomic_xchg(&objcg->nr_charged_bytes, 0) : 0;
+	slot = obj_stock_find(stock, objcg);
+	if (!slot) {
+		slot = obj_stock_get_slot(stock, objcg, &old);
 		allow_uncharge = true;	/* Allow uncharge when objcg changes */
+	} else {
+		slot->last_used = ++stock->clock;
 	}
-	stock->nr_bytes += nr_bytes;
+	slot->nr_bytes += nr_bytes;
 
-	if (allow_uncharge && (stock->nr_bytes > PAGE_SIZE)) {
-		nr_pages = stock->nr_bytes >> PAGE_SHIFT;
-		stock->nr_bytes &= (PAGE_SIZE - 1);
+	if (allow_uncharge && (slot->nr_bytes > PAGE_SIZE)) {
+		nr_pages = slot->nr_bytes >> PAGE_SHIFT;
+		slot->nr_bytes &= (PAGE_SIZE - 1);
 	}
 
 	local_unlock_irqrestore(&memcg_stock.stock_lock, flags);
@@ -3663,7 +3914,7 @@ static unsigned long mem_cgroup_usage(struct mem_cgroup *memcg, bool swap)
 	unsigned long val;
 
 	if (mem_cgroup_is_root(memcg)) {
-		mem_cgroup_flush_stats();
+		mem_cgroup_flush_stats(memcg);
 		val = memcg_page_state(memcg, NR_FILE_PAGES) +
 			memcg_page_state(memcg, NR_ANON_MAPPED);
 		if (swap)
@@ -4009,7 +4260,7 @@ static int memcg_numa_stat_show(struct seq_file *m, void *v)
 	int nid;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (stat = stats; stat < stats + ARRAY_SIZE(stats); stat++) {
 		seq_printf(m, "%s=%lu", stat->name,
@@ -4085,7 +4336,7 @@ static int memcg_stat_show(struct seq_file *m, void *v)
 
 	BUILD_BUG_ON(ARRAY_SIZE(memcg1_stat_names) != ARRAY_SIZE(memcg1_stats));
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memcg1_stats); i++) {
 		unsigned long nr;
@@ -4589,7 +4840,7 @@ void mem_cgroup_wb_stats(struct bdi_writeback *wb, unsigned long *pfilepages,
 	struct mem_cgroup *memcg = mem_cgroup_from_css(wb->memcg_css);
 	struct mem_cgroup *parent;
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	*pdirty = memcg_page_state(memcg, NR_FILE_DIRTY);
 	*pwriteback = memcg_page_state(memcg, NR_WRITEBACK);
@@ -5578,6 +5829,11 @@ static void mem_cgroup_css_rstat_flush(struct cgroup_subsys_state *css, int cpu)
 				ppn->lruvec_stats.state_pending[i] += delta;
 		}
 	}
+
+	WRITE_ONCE(statc->stats_updates, 0);
+	/* We are in a per-cpu loop here, only do the atomic write once */
+	if (atomic64_read(&memcg->vmstats->stats_updates))
+		atomic64_set(&memcg->vmstats->stats_updates, 0);
 }
 
 #ifdef CONFIG_MMU
@@ -6545,7 +6801,7 @@ static int memory_numa_stat_show(struct seq_file *m, void *v)
 	int i;
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
 
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(memcg);
 
 	for (i = 0; i < ARRAY_SIZE(memory_stats); i++) {
 		int nid;
@@ -6971,15 +7227,14 @@ int mem_cgroup_swapin_charge_folio(struct folio *folio, struct mm_struct *mm,
 }
 
 /*
- * mem_cgroup_swapin_uncharge_swap - uncharge swap slot
- * @entry: swap entry for which the page is charged
- *
- * Call this function after successfully adding the charged page to swapcache.
+ * mem_cgroup_swapin_uncharge_swap - uncharge swap slots
+ * @entry: first swap entry for which the folio is charged
+ * @nr_pages: number of swap slots, one per page of the folio
  *
- * Note: This function assumes the page for which swap slot is being uncharged
- * is order 0 page.
+ * Call this function after successfully adding the charged folio to
+ * swapcache.
  */
-void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry)
+void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry, unsigned int nr_pages)
 {
 	/*
 	 * Cgroup1's unified memory+swap counter has been charged with the
@@ -6999,7 +7254,7 @@ void mem_cgroup_swapin_uncharge_swap(swp_entry_t entry)
 		 * let's not wait for it.  The page already received a
 		 * memory+swap charge, drop the swap entry duplicate.
 		 */
-		mem_cgroup_uncharge_swap(entry, 1);
+		mem_cgroup_uncharge_swap(entry, nr_pages);
 	}
 }
 
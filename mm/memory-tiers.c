@@ -5,6 +5,8 @@
 #include <linux/kobject.h>
 #include <linux/memory.h>
 #include <linux/memory-tiers.h>
+#include <linux/vmstat.h>
+#include <linux/sched/sysctl.h>
 
 #include "internal.h"
 
@@ -145,8 +147,48 @@ static ssize_t nodelist_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(nodelist);
 
+/*
+ * Promotions are accounted to the node promoted to, demotions to the node
+ * demoted from.
+ */
+static const enum node_stat_item memtier_stat_items[] = {
+#ifdef CONFIG_NUMA_BALANCING
+	PGPROMOTE_SUCCESS,
+	PGPROMOTE_CANDIDATE,
+#endif
+	PGDEMOTE_KSWAPD,
+	PGDEMOTE_DIRECT,
+};
+
+static ssize_t vmstat_show(struct device *dev,
+			   struct device_attribute *attr, char *buf)
+{
+	unsigned long sum[ARRAY_SIZE(memtier_stat_items)] = { };
+	nodemask_t nmask;
+	int i, node, len = 0;
+
+	mutex_lock(&memory_tier_lock);
+	nmask = get_memtier_nodemask(to_memory_tier(dev));
+	for_each_node_mask(node, nmask) {
+		if (!NODE_DATA(node))
+			continue;
+		for (i = 0; i < ARRAY_SIZE(memtier_stat_items); i++)
+			sum[i] += node_page_state_pages(NODE_DATA(node),
+							memtier_stat_items[i]);
+	}
+	mutex_unlock(&memory_tier_lock);
+
+	for (i = 0; i < ARRAY_SIZE(memtier_stat_items); i++)
+		len += sysfs_emit_at(buf, len, "%s %lu\n",
+				     node_stat_name(memtier_stat_items[i]),
+				     sum[i]);
+	return len;
+}
+static DEVICE_ATTR_RO(vmstat);
+
 static struct attribute *memtier_dev_attrs[] = {
 	&dev_attr_nodelist.attr,
+	&dev_attr_vmstat.attr,
 	NULL
 };
 
@@ -282,6 +324,25 @@ void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets)
 	rcu_read_unlock();
 }
 
+#ifdef CONFIG_NUMA_BALANCING
+/*
+ * The promotion rate limit is global, the hot threshold it tunes lives in
+ * the pgdat of the top tier node promoted to, see
+ * should_numa_migrate_memory().
+ */
+unsigned int node_promote_rate_limit(int node)
+{
+	return READ_ONCE(sysctl_numa_balancing_promote_rate_limit);
+}
+
+unsigned int node_promote_hot_threshold(int node)
+{
+	unsigned int th = READ_ONCE(NODE_DATA(node)->nbp_threshold);
+
+	return th ? : sysctl_numa_balancing_hot_threshold;
+}
+#endif /* CONFIG_NUMA_BALANCING */
+
 /**
  * next_demotion_node() - Get the next node in the demotion path
  * @node: The starting node to lookup the next node
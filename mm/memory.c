@@ -63,6 +63,7 @@
 #include <linux/memcontrol.h>
 #include <linux/mmu_notifier.h>
 #include <linux/swapops.h>
+#include <linux/frontswap.h>
 #include <linux/elf.h>
 #include <linux/gfp.h>
 #include <linux/migrate.h>
@@ -3745,6 +3746,194 @@ static vm_fault_t handle_pte_marker(struct vm_fault *vmf)
 	return VM_FAULT_SIGBUS;
 }
 
+/*
+ * Architectures which restore per-page metadata from the swap entry do
+ * that for a single page only, so they keep swapping in order-0 pages.
+ */
+#if defined(CONFIG_THP_SWAP) && !defined(__HAVE_ARCH_SWAP_RESTORE)
+/*
+ * Whether the PMD-sized range of ptes still holds the run of exclusive
+ * swap entries starting at @first, as left behind by a THP that was
+ * swapped out whole.
+ */
+static bool thp_swap_ptes_match(pte_t *ptep, swp_entry_t first)
+{
+	unsigned long i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		pte_t pte = ptep[i];
+		swp_entry_t entry;
+
+		if (!is_swap_pte(pte) || !pte_swp_exclusive(pte) ||
+		    pte_swp_uffd_wp(pte))
+			return false;
+
+		entry = pte_to_swp_entry(pte);
+		if (non_swap_entry(entry) || swp_type(entry) != swp_type(first) ||
+		    swp_offset(entry) != swp_offset(first) + i)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Try to bring back a THP that was swapped out as a whole as a single
+ * folio, mapped by ptes. Like the SWP_SYNCHRONOUS_IO path, the folio
+ * bypasses the swapcache: SWAP_HAS_CACHE is held on every entry while
+ * the folio is read and mapped, which keeps parallel faults away.
+ *
+ * Returns VM_FAULT_FALLBACK if the range does not qualify, or the folio
+ * could not be allocated, and the caller should swap in a single page.
+ */
+static vm_fault_t do_swap_thp(struct vm_fault *vmf,
+			      struct swap_info_struct *si, swp_entry_t entry)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long haddr = vmf->address & HPAGE_PMD_MASK;
+	unsigned long idx = (vmf->address - haddr) >> PAGE_SHIFT;
+	int type = swp_type(entry);
+	pgoff_t offset = swp_offset(entry);
+	vm_fault_t ret = VM_FAULT_FALLBACK;
+	struct folio *folio;
+	swp_entry_t first;
+	void *shadow;
+	pte_t *ptep;
+	bool match;
+	int i, nr, err;
+
+	if (userfaultfd_armed(vma) || !transhuge_vma_suitable(vma, haddr) ||
+	    !hugepage_vma_check(vma, vma->vm_flags, false, true, true))
+		return VM_FAULT_FALLBACK;
+
+	/* The run must cover one whole swap cluster */
+	if (offset < idx || !IS_ALIGNED(offset - idx, HPAGE_PMD_NR))
+		return VM_FAULT_FALLBACK;
+	first = swp_entry(type, offset - idx);
+
+	if (!frontswap_test_uniform(type, swp_offset(first), HPAGE_PMD_NR))
+		return VM_FAULT_FALLBACK;
+
+	ptep = pte_offset_map_lock(vma->vm_mm, vmf->pmd, haddr, &vmf->ptl);
+	match = thp_swap_ptes_match(ptep, first);
+	pte_unmap_unlock(ptep, vmf->ptl);
+	if (!match)
+		return VM_FAULT_FALLBACK;
+
+	for (nr = 0; nr < HPAGE_PMD_NR; nr++) {
+		swp_entry_t e = swp_entry(type, swp_offset(first) + nr);
+
+		if (__swap_count(e) != 1 || swapcache_prepare(e))
+			goto out_clear;
+	}
+
+	folio = vma_alloc_folio(vma_thp_gfp_mask(vma), HPAGE_PMD_ORDER,
+				vma, haddr, true);
+	if (!folio) {
+		count_vm_event(THP_SWPIN_FALLBACK);
+		goto out_clear;
+	}
+	__folio_set_locked(folio);
+	__folio_set_swapbacked(folio);
+
+	if (mem_cgroup_swapin_charge_folio(folio, vma->vm_mm, GFP_KERNEL,
+					   first)) {
+		folio_put(folio);
+		count_vm_event(THP_SWPIN_FALLBACK);
+		goto out_clear;
+	}
+	mem_cgroup_swapin_uncharge_swap(first, HPAGE_PMD_NR);
+
+	shadow = get_shadow_from_swap_cache(first);
+	if (shadow)
+		workingset_refault(folio, shadow);
+
+	folio_add_lru(folio);
+
+	/* To provide entry to swap_readpage() */
+	folio_set_swap_entry(folio, first);
+	err = swap_readpage(&folio->page, true, NULL);
+	folio->private = NULL;
+	if (err == -EAGAIN) {
+		/*
+		 * Some entries were written back from frontswap since they
+		 * were stored, so neither it nor the swap device holds the
+		 * whole folio: swap the pages in one at a time instead.
+		 */
+		folio_put(folio);
+		count_vm_event(THP_SWPIN_FALLBACK);
+		goto out_clear;
+	}
+
+	/* Had to read the folio from swap area: Major fault */
+	ret = VM_FAULT_MAJOR;
+	count_vm_event(PGMAJFAULT);
+	count_memcg_event_mm(vma->vm_mm, PGMAJFAULT);
+
+	folio_lock(folio);
+	cgroup_throttle_swaprate(&folio->page, GFP_KERNEL);
+
+	ptep = pte_offset_map_lock(vma->vm_mm, vmf->pmd, haddr, &vmf->ptl);
+	if (unlikely(!thp_swap_ptes_match(ptep, first)))
+		goto out_nomap;
+
+	if (unlikely(!folio_test_uptodate(folio))) {
+		ret = VM_FAULT_SIGBUS;
+		goto out_nomap;
+	}
+
+	/* Every pte mapping a subpage holds a reference */
+	folio_ref_add(folio, HPAGE_PMD_NR - 1);
+
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		struct page *page = folio_page(folio, i);
+		unsigned long addr = haddr + i * PAGE_SIZE;
+		pte_t orig_pte = ptep[i];
+		pte_t pte = mk_pte(page, vma->vm_page_prot);
+
+		if (i == idx && (vmf->flags & FAULT_FLAG_WRITE))
+			pte = maybe_mkwrite(pte_mkdirty(pte), vma);
+		if (pte_swp_soft_dirty(orig_pte))
+			pte = pte_mksoft_dirty(pte);
+
+		swap_free(swp_entry(type, swp_offset(first) + i));
+		flush_icache_page(vma, page);
+		/* The head page goes first and sets up the folio's anon_vma */
+		page_add_anon_rmap(page, vma, addr, RMAP_EXCLUSIVE);
+		set_pte_at(vma->vm_mm, addr, ptep + i, pte);
+		arch_do_swap_page(vma->vm_mm, vma, addr, pte, orig_pte);
+		update_mmu_cache(vma, addr, ptep + i);
+	}
+
+	if (vmf->flags & FAULT_FLAG_WRITE) {
+		vmf->flags &= ~FAULT_FLAG_WRITE;
+		ret |= VM_FAULT_WRITE;
+	}
+	add_mm_counter(vma->vm_mm, MM_ANONPAGES, HPAGE_PMD_NR);
+	add_mm_counter(vma->vm_mm, MM_SWAPENTS, -HPAGE_PMD_NR);
+	count_vm_event(THP_SWPIN);
+
+	pte_unmap_unlock(ptep, vmf->ptl);
+	folio_unlock(folio);
+	goto out_clear;
+
+out_nomap:
+	pte_unmap_unlock(ptep, vmf->ptl);
+	folio_unlock(folio);
+	folio_put(folio);
+out_clear:
+	while (nr--)
+		swapcache_clear(si, swp_entry(type, swp_offset(first) + nr));
+	return ret;
+}
+#else
+static inline vm_fault_t do_swap_thp(struct vm_fault *vmf,
+				     struct swap_info_struct *si,
+				     swp_entry_t entry)
+{
+	return VM_FAULT_FALLBACK;
+}
+#endif
+
 /*
  * We enter with non-exclusive mmap_lock (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
@@ -3820,6 +4009,11 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 	swapcache = folio;
 
 	if (!folio) {
+		ret = do_swap_thp(vmf, si, entry);
+		if (ret != VM_FAULT_FALLBACK)
+			goto out;
+		ret = 0;
+
 		if (data_race(si->flags & SWP_SYNCHRONOUS_IO) &&
 		    __swap_count(entry) == 1) {
 			/*
@@ -3850,7 +4044,7 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 					ret = VM_FAULT_OOM;
 					goto out_page;
 				}
-				mem_cgroup_swapin_uncharge_swap(entry);
+				mem_cgroup_swapin_uncharge_swap(entry, 1);
 
 				shadow = get_shadow_from_swap_cache(entry);
 				if (shadow)
@@ -4491,7 +4685,7 @@ vm_fault_t finish_fault(struct vm_fault *vmf)
 	return ret;
 }
 
-static unsigned long fault_around_bytes __read_mostly =
+unsigned long fault_around_bytes __read_mostly =
 	rounddown_pow_of_two(65536);
 
 #ifdef CONFIG_DEBUG_FS
@@ -51,6 +51,7 @@
 #include <linux/random.h>
 #include <linux/sched/sysctl.h>
 #include <linux/memory-tiers.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 
@@ -627,9 +628,93 @@ void folio_migrate_flags(struct folio *newfolio, struct folio *folio)
 }
 EXPORT_SYMBOL(folio_migrate_flags);
 
+/*
+ * Copying a large folio is split into chunks spread over up to
+ * migrate_copy_threads CPUs, preferably on the node of the destination.
+ * The migrating task copies the first chunk itself.
+ */
+#define MIGRATE_COPY_MAX_THREADS	32
+/* Smaller folios are not worth the round trips through the workqueue */
+#define MIGRATE_COPY_MIN_NR_PAGES	(SZ_2M / PAGE_SIZE)
+
+static unsigned int migrate_copy_threads = 1;
+static struct workqueue_struct *migrate_copy_wq;
+
+struct migrate_copy_work {
+	struct work_struct work;
+	struct folio *dst;
+	struct folio *src;
+	long start;
+	long nr;
+};
+
+static void folio_copy_chunk(struct folio *dst, struct folio *src,
+			     long start, long nr)
+{
+	long i;
+
+	for (i = start; i < start + nr; i++) {
+		copy_highpage(folio_page(dst, i), folio_page(src, i));
+		cond_resched();
+	}
+}
+
+static void migrate_copy_work_fn(struct work_struct *work)
+{
+	struct migrate_copy_work *mcw =
+		container_of(work, struct migrate_copy_work, work);
+
+	folio_copy_chunk(mcw->dst, mcw->src, mcw->start, mcw->nr);
+}
+
+/*
+ * Returns false, without copying anything, if the folio should be copied
+ * the usual way instead.
+ */
+static bool folio_copy_parallel(struct folio *dst, struct folio *src)
+{
+	unsigned int nr_threads = READ_ONCE(migrate_copy_threads);
+	long nr = folio_nr_pages(src);
+	struct migrate_copy_work *works;
+	int nid = folio_nid(dst);
+	long chunk, start;
+	unsigned int i;
+
+	if (nr_threads <= 1 || nr < MIGRATE_COPY_MIN_NR_PAGES ||
+	    !migrate_copy_wq)
+		return false;
+
+	/* Migration often runs under memory pressure: do not insist */
+	works = kcalloc(nr_threads - 1, sizeof(*works),
+			GFP_NOWAIT | __GFP_NOWARN);
+	if (!works)
+		return false;
+
+	chunk = DIV_ROUND_UP(nr, nr_threads);
+	for (i = 0, start = chunk; start < nr; i++, start += chunk) {
+		works[i].dst = dst;
+		works[i].src = src;
+		works[i].start = start;
+		works[i].nr = min(chunk, nr - start);
+		INIT_WORK(&works[i].work, migrate_copy_work_fn);
+		queue_work_node(nid, migrate_copy_wq, &works[i].work);
+	}
+
+	folio_copy_chunk(dst, src, 0, min(chunk, nr));
+
+	while (i--)
+		flush_work(&works[i].work);
+	kfree(works);
+
+	count_vm_event(PGMIGRATE_COPY_PARALLEL);
+	return true;
+}
+
 void folio_migrate_copy(struct folio *newfolio, struct folio *folio)
 {
-	folio_copy(newfolio, folio);
+	if (!folio_copy_parallel(newfolio, folio))
+		folio_copy(newfolio, folio);
+	count_vm_events(PGMIGRATE_COPY_BYTES, folio_size(folio));
 	folio_migrate_flags(newfolio, folio);
 }
 EXPORT_SYMBOL(folio_migrate_copy);
@@ -1011,13 +1096,124 @@ static int move_to_new_folio(struct folio *dst, struct folio *src,
 	return rc;
 }
 
-static int __unmap_and_move(struct folio *src, struct folio *dst,
-				int force, enum migrate_mode mode)
+/*
+ * Between the unmap and the move stage of a batch, dst->private carries the
+ * anon_vma reference taken on src and whether src was mapped: both are
+ * needed to finish or to undo the migration.
+ */
+#define PAGE_WAS_MAPPED		1UL
+
+static void __migrate_folio_record(struct folio *dst,
+				   unsigned long page_was_mapped,
+				   struct anon_vma *anon_vma)
 {
+	dst->private = (void *)anon_vma + page_was_mapped;
+}
+
+static void __migrate_folio_extract(struct folio *dst,
+				    int *page_was_mappedp,
+				    struct anon_vma **anon_vmap)
+{
+	unsigned long private = (unsigned long)dst->private;
+
+	*anon_vmap = (struct anon_vma *)(private & ~PAGE_WAS_MAPPED);
+	*page_was_mappedp = private & PAGE_WAS_MAPPED;
+	dst->private = NULL;
+}
+
+/* Restore src after a failed migration, and put it on @ret if not NULL */
+static void migrate_folio_undo_src(struct folio *src, int page_was_mapped,
+				   struct anon_vma *anon_vma, bool locked,
+				   struct list_head *ret)
+{
+	if (page_was_mapped)
+		remove_migration_ptes(src, src, false);
+	/* Drop an anon_vma reference if we took one */
+	if (anon_vma)
+		put_anon_vma(anon_vma);
+	if (locked)
+		folio_unlock(src);
+	if (ret)
+		list_move_tail(&src->lru, ret);
+}
+
+/* Release dst after a failed migration */
+static void migrate_folio_undo_dst(struct folio *dst, bool locked,
+				   free_page_t put_new_page,
+				   unsigned long private)
+{
+	if (locked)
+		folio_unlock(dst);
+	if (put_new_page)
+		put_new_page(&dst->page, private);
+	else
+		folio_put(dst);
+}
+
+/* Drop the isolation of a src folio that has been migrated or freed */
+static void migrate_folio_done(struct folio *src, enum migrate_reason reason)
+{
+	/*
+	 * Compaction can migrate also non-LRU pages which are
+	 * not accounted to NR_ISOLATED_*. They can be recognized
+	 * as __PageMovable
+	 */
+	if (likely(!__PageMovable(&src->page)))
+		mod_node_page_state(folio_pgdat(src), NR_ISOLATED_ANON +
+				folio_is_file_lru(src), -folio_nr_pages(src));
+
+	if (reason != MR_MEMORY_FAILURE)
+		/*
+		 * We release the page in page_handle_poison.
+		 */
+		folio_put(src);
+}
+
+/*
+ * Obtain the lock on src, allocate dst and replace all ptes of src with
+ * migration entries. The TLB flush is deferred: the caller must issue
+ * try_to_unmap_flush() before migrate_folio_move() copies the folio.
+ *
+ * Returns MIGRATEPAGE_UNMAP with src and dst locked if the folio is ready to
+ * be moved, MIGRATEPAGE_SUCCESS if src was freed under us, or an error with
+ * everything restored.
+ */
+static int migrate_folio_unmap(new_page_t get_new_page,
+			       free_page_t put_new_page, unsigned long private,
+			       struct folio *src, struct folio **dstp,
+			       int force, enum migrate_mode mode,
+			       enum migrate_reason reason,
+			       struct list_head *ret)
+{
+	struct folio *dst;
 	int rc = -EAGAIN;
-	bool page_was_mapped = false;
+	struct page *newpage;
+	int page_was_mapped = 0;
 	struct anon_vma *anon_vma = NULL;
 	bool is_lru = !__PageMovable(&src->page);
+	bool locked = false;
+	bool dst_locked = false;
+
+	if (!thp_migration_supported() && folio_test_transhuge(src))
+		return -ENOSYS;
+
+	if (folio_ref_count(src) == 1) {
+		/* Page was freed from under us. So we are done. */
+		folio_clear_active(src);
+		folio_clear_unevictable(src);
+		/* free_pages_prepare() will clear PG_isolated. */
+		list_del(&src->lru);
+		migrate_folio_done(src, reason);
+		return MIGRATEPAGE_SUCCESS;
+	}
+
+	newpage = get_new_page(&src->page, private);
+	if (!newpage)
+		return -ENOMEM;
+	dst = page_folio(newpage);
+	*dstp = dst;
+
+	dst->private = NULL;
 
 	if (!folio_trylock(src)) {
 		if (!force || mode == MIGRATE_ASYNC)
@@ -1041,6 +1237,7 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 
 		folio_lock(src);
 	}
+	locked = true;
 
 	if (folio_test_writeback(src)) {
 		/*
@@ -1055,10 +1252,10 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 			break;
 		default:
 			rc = -EBUSY;
-			goto out_unlock;
+			goto out;
 		}
 		if (!force)
-			goto out_unlock;
+			goto out;
 		folio_wait_writeback(src);
 	}
 
@@ -1088,11 +1285,12 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 	 * This is much like races on refcount of oldpage: just don't BUG().
 	 */
 	if (unlikely(!folio_trylock(dst)))
-		goto out_unlock;
+		goto out;
+	dst_locked = true;
 
 	if (unlikely(!is_lru)) {
-		rc = move_to_new_folio(dst, src, mode);
-		goto out_unlock_both;
+		__migrate_folio_record(dst, page_was_mapped, anon_vma);
+		return MIGRATEPAGE_UNMAP;
 	}
 
 	/*
@@ -1110,18 +1308,52 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 	if (!src->mapping) {
 		if (folio_test_private(src)) {
 			try_to_free_buffers(src);
-			goto out_unlock_both;
+			goto out;
 		}
 	} else if (folio_mapped(src)) {
 		/* Establish migration ptes */
 		VM_BUG_ON_FOLIO(folio_test_anon(src) &&
 			       !folio_test_ksm(src) && !anon_vma, src);
-		try_to_migrate(src, 0);
-		page_was_mapped = true;
+		try_to_migrate(src, TTU_BATCH_FLUSH);
+		page_was_mapped = 1;
 	}
 
-	if (!folio_mapped(src))
-		rc = move_to_new_folio(dst, src, mode);
+	if (!folio_mapped(src)) {
+		__migrate_folio_record(dst, page_was_mapped, anon_vma);
+		return MIGRATEPAGE_UNMAP;
+	}
+
+out:
+	/*
+	 * A page that has not been unmapped will be restored to
+	 * right list unless we want to retry.
+	 */
+	if (rc == -EAGAIN)
+		ret = NULL;
+
+	migrate_folio_undo_src(src, page_was_mapped, anon_vma, locked, ret);
+	migrate_folio_undo_dst(dst, dst_locked, put_new_page, private);
+
+	return rc;
+}
+
+/*
+ * Migrate an unmapped src to dst, then restore the ptes to point to dst on
+ * success, or back to src otherwise.
+ */
+static int migrate_folio_move(free_page_t put_new_page, unsigned long private,
+			      struct folio *src, struct folio *dst,
+			      enum migrate_mode mode, enum migrate_reason reason,
+			      struct list_head *ret)
+{
+	int rc;
+	int page_was_mapped = 0;
+	struct anon_vma *anon_vma = NULL;
+	bool is_lru = !__PageMovable(&src->page);
+
+	__migrate_folio_extract(dst, &page_was_mapped, &anon_vma);
+
+	rc = move_to_new_folio(dst, src, mode);
 
 	/*
 	 * When successful, push dst to LRU immediately: so that if it
@@ -1132,7 +1364,7 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 	 * unsuccessful, and other cases when a page has been temporarily
 	 * isolated from the unevictable LRU: but this case is the easiest.
 	 */
-	if (rc == MIGRATEPAGE_SUCCESS) {
+	if (rc == MIGRATEPAGE_SUCCESS && likely(is_lru)) {
 		folio_add_lru(dst);
 		if (page_was_mapped)
 			lru_add_drain();
@@ -1142,106 +1374,39 @@ static int __unmap_and_move(struct folio *src, struct folio *dst,
 		remove_migration_ptes(src,
 			rc == MIGRATEPAGE_SUCCESS ? dst : src, false);
 
-out_unlock_both:
 	folio_unlock(dst);
-out_unlock:
 	/* Drop an anon_vma reference if we took one */
 	if (anon_vma)
 		put_anon_vma(anon_vma);
 	folio_unlock(src);
-out:
-	/*
-	 * If migration is successful, decrease refcount of dst,
-	 * which will not free the page because new page owner increased
-	 * refcounter.
-	 */
-	if (rc == MIGRATEPAGE_SUCCESS)
-		folio_put(dst);
-
-	return rc;
-}
-
-/*
- * Obtain the lock on page, remove all ptes and migrate the page
- * to the newly allocated page in newpage.
- */
-static int unmap_and_move(new_page_t get_new_page,
-				   free_page_t put_new_page,
-				   unsigned long private, struct page *page,
-				   int force, enum migrate_mode mode,
-				   enum migrate_reason reason,
-				   struct list_head *ret)
-{
-	struct folio *dst, *src = page_folio(page);
-	int rc = MIGRATEPAGE_SUCCESS;
-	struct page *newpage = NULL;
 
-	if (!thp_migration_supported() && PageTransHuge(page))
-		return -ENOSYS;
-
-	if (page_count(page) == 1) {
-		/* Page was freed from under us. So we are done. */
-		ClearPageActive(page);
-		ClearPageUnevictable(page);
-		/* free_pages_prepare() will clear PG_isolated. */
-		goto out;
-	}
-
-	newpage = get_new_page(page, private);
-	if (!newpage)
-		return -ENOMEM;
-	dst = page_folio(newpage);
-
-	newpage->private = 0;
-	rc = __unmap_and_move(src, dst, force, mode);
-	if (rc == MIGRATEPAGE_SUCCESS)
-		set_page_owner_migrate_reason(newpage, reason);
-
-out:
-	if (rc != -EAGAIN) {
+	if (rc == MIGRATEPAGE_SUCCESS) {
 		/*
-		 * A page that has been migrated has all references
-		 * removed and will be freed. A page that has not been
-		 * migrated will have kept its references and be restored.
+		 * Decrease refcount of dst, which will not free the page
+		 * because new page owner increased refcounter.
 		 */
-		list_del(&page->lru);
-	}
+		folio_put(dst);
+		set_page_owner_migrate_reason(&dst->page, reason);
 
-	/*
-	 * If migration is successful, releases reference grabbed during
-	 * isolation. Otherwise, restore the page to right list unless
-	 * we want to retry.
-	 */
-	if (rc == MIGRATEPAGE_SUCCESS) {
 		/*
-		 * Compaction can migrate also non-LRU pages which are
-		 * not accounted to NR_ISOLATED_*. They can be recognized
-		 * as __PageMovable
+		 * A page that has been migrated has all references removed
+		 * and will be freed.
 		 */
-		if (likely(!__PageMovable(page)))
-			mod_node_page_state(page_pgdat(page), NR_ISOLATED_ANON +
-					page_is_file_lru(page), -thp_nr_pages(page));
-
-		if (reason != MR_MEMORY_FAILURE)
-			/*
-			 * We release the page in page_handle_poison.
-			 */
-			put_page(page);
+		list_del(&src->lru);
+		migrate_folio_done(src, reason);
 	} else {
+		/* Restore src to the right list unless we want to retry */
 		if (rc != -EAGAIN)
-			list_add_tail(&page->lru, ret);
-
-		if (put_new_page)
-			put_new_page(newpage, private);
-		else
-			put_page(newpage);
+			list_move_tail(&src->lru, ret);
+		migrate_folio_undo_dst(dst, false, put_new_page, private);
 	}
 
 	return rc;
 }
 
 /*
- * Counterpart of unmap_and_move_page() for hugepage migration.
+ * Counterpart of migrate_folio_unmap() and migrate_folio_move() for hugepage
+ * migration.
  *
  * This function doesn't wait the completion of hugepage I/O
  * because there is no race between I/O and migration for hugepage.
@@ -1398,6 +1563,81 @@ static inline int try_split_thp(struct page *page, struct list_head *split_pages
 	return rc;
 }
 
+/* Maximum number of folios unmapped behind one deferred TLB flush */
+#define NR_MAX_BATCHED_MIGRATION	512
+
+struct migrate_pages_stats {
+	int nr_succeeded;	/* Normal pages and THP subpages migrated */
+	int nr_failed;		/* Normal pages and hugetlb pages not migrated */
+	int nr_failed_pages;	/* Normal pages and THP subpages not migrated */
+	int nr_retry_pages;	/* Normal pages and THP subpages to retry */
+	int retry;		/* Normal pages and hugetlb pages to retry */
+	int thp_retry;		/* THPs to retry */
+	int nr_thp_succeeded;	/* THPs migrated */
+	int nr_thp_failed;	/* THPs not migrated */
+	int nr_thp_split;	/* THPs split before migrating */
+	bool no_subpage_counting;
+};
+
+/*
+ * Move the folios unmapped so far in a batch to their new folios. A single
+ * TLB flush covers the unmapping of all of them: it must happen before any
+ * copy, as a remote CPU may still write through a stale TLB entry until then.
+ */
+static void migrate_pages_batch_move(struct list_head *unmap_pages,
+				     struct list_head *dst_pages,
+				     free_page_t put_new_page,
+				     unsigned long private,
+				     enum migrate_mode mode, int reason,
+				     struct list_head *retry_pages,
+				     struct list_head *ret_pages,
+				     struct migrate_pages_stats *stats)
+{
+	struct folio *src, *src2, *dst;
+	int rc, nr_subpages;
+	bool is_thp;
+
+	if (list_empty(unmap_pages))
+		return;
+
+	try_to_unmap_flush();
+
+	list_for_each_entry_safe(src, src2, unmap_pages, lru) {
+		is_thp = folio_test_transhuge(src);
+		nr_subpages = folio_nr_pages(src);
+		cond_resched();
+
+		/* dst_pages is in the same order as unmap_pages */
+		dst = list_first_entry(dst_pages, struct folio, lru);
+		list_del(&dst->lru);
+		rc = migrate_folio_move(put_new_page, private, src, dst, mode,
+					reason, ret_pages);
+		switch (rc) {
+		case MIGRATEPAGE_SUCCESS:
+			stats->nr_succeeded += nr_subpages;
+			if (is_thp)
+				stats->nr_thp_succeeded++;
+			break;
+		case -EAGAIN:
+			if (is_thp)
+				stats->thp_retry++;
+			else if (!stats->no_subpage_counting)
+				stats->retry++;
+			stats->nr_retry_pages += nr_subpages;
+			/* Back on the from list once this pass is over */
+			list_move_tail(&src->lru, retry_pages);
+			break;
+		default:
+			if (is_thp)
+				stats->nr_thp_failed++;
+			else if (!stats->no_subpage_counting)
+				stats->nr_failed++;
+			stats->nr_failed_pages += nr_subpages;
+			break;
+		}
+	}
+}
+
 /*
  * migrate_pages - migrate the pages specified in a list, to the free pages
  *		   supplied as the target for the page migration
@@ -1414,6 +1654,14 @@ static inline int try_split_thp(struct page *page, struct list_head *split_pages
  * @ret_succeeded:	Set to the number of normal pages migrated successfully if
  *			the caller passes a non-NULL pointer.
  *
+ * In MIGRATE_ASYNC mode, normal pages and THPs are migrated in batches of
+ * up to NR_MAX_BATCHED_MIGRATION: all of them are unmapped first, then the
+ * TLB is flushed once for the whole batch, and then they are all moved.
+ * The other modes migrate one folio at a time: moving a folio may then
+ * lock its buffers or write it out, which can wait on I/O that needs the
+ * lock of another folio of the batch.  Hugetlb pages are always migrated
+ * one at a time.
+ *
  * The function returns after 10 attempts or if no pages are movable any more
  * because the list has become empty or no retryable pages exist any more.
  * It is caller's responsibility to call putback_movable_pages() to return pages
@@ -1427,32 +1675,29 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 		free_page_t put_new_page, unsigned long private,
 		enum migrate_mode mode, int reason, unsigned int *ret_succeeded)
 {
-	int retry = 1;
-	int thp_retry = 1;
-	int nr_failed = 0;
-	int nr_failed_pages = 0;
-	int nr_retry_pages = 0;
-	int nr_succeeded = 0;
-	int nr_thp_succeeded = 0;
-	int nr_thp_failed = 0;
-	int nr_thp_split = 0;
+	struct migrate_pages_stats stats = { .retry = 1, .thp_retry = 1 };
 	int pass = 0;
+	int nr_batched = 0;
+	int batch_max = mode == MIGRATE_ASYNC ? NR_MAX_BATCHED_MIGRATION : 1;
 	bool is_thp = false;
 	struct page *page;
 	struct page *page2;
+	struct folio *dst = NULL;
 	int rc, nr_subpages;
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(thp_split_pages);
+	LIST_HEAD(unmap_pages);
+	LIST_HEAD(dst_pages);
+	LIST_HEAD(retry_pages);
 	bool nosplit = (reason == MR_NUMA_MISPLACED);
-	bool no_subpage_counting = false;
 
 	trace_mm_migrate_pages_start(mode, reason);
 
 thp_subpage_migration:
-	for (pass = 0; pass < 10 && (retry || thp_retry); pass++) {
-		retry = 0;
-		thp_retry = 0;
-		nr_retry_pages = 0;
+	for (pass = 0; pass < 10 && (stats.retry || stats.thp_retry); pass++) {
+		stats.retry = 0;
+		stats.thp_retry = 0;
+		stats.nr_retry_pages = 0;
 
 		list_for_each_entry_safe(page, page2, from, lru) {
 			/*
@@ -1463,20 +1708,31 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 			is_thp = PageTransHuge(page) && !PageHuge(page);
 			nr_subpages = compound_nr(page);
 			cond_resched();
-
-			if (PageHuge(page))
+			if (PageHuge(page)) {
+				/* It may sleep on its lock: move the batch */
+				migrate_pages_batch_move(&unmap_pages,
+						&dst_pages, put_new_page,
+						private, mode, reason,
+						&retry_pages, &ret_pages,
+						&stats);
+				nr_batched = 0;
 				rc = unmap_and_move_huge_page(get_new_page,
 						put_new_page, private, page,
 						pass > 2, mode, reason,
 						&ret_pages);
-			else
-				rc = unmap_and_move(get_new_page, put_new_page,
-						private, page, pass > 2, mode,
-						reason, &ret_pages);
+			} else {
+				rc = migrate_folio_unmap(get_new_page,
+						put_new_page, private,
+						page_folio(page), &dst,
+						pass > 2, mode, reason,
+						&ret_pages);
+			}
 			/*
 			 * The rules are:
 			 *	Success: non hugetlb page will be freed, hugetlb
 			 *		 page will be put back
+			 *	Unmap: moved to unmap_pages until the batch is
+			 *	       moved, when it follows the other rules
 			 *	-EAGAIN: stay on the from list
 			 *	-ENOMEM: stay on the from list
 			 *	-ENOSYS: stay on the from list
@@ -1484,6 +1740,18 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 			 *		     from list
 			 */
 			switch(rc) {
+			case MIGRATEPAGE_UNMAP:
+				list_move_tail(&page->lru, &unmap_pages);
+				list_add_tail(&dst->lru, &dst_pages);
+				if (++nr_batched < batch_max)
+					break;
+				migrate_pages_batch_move(&unmap_pages,
+						&dst_pages, put_new_page,
+						private, mode, reason,
+						&retry_pages, &ret_pages,
+						&stats);
+				nr_batched = 0;
+				break;
 			/*
 			 * THP migration might be unsupported or the
 			 * allocation could've failed so we should
@@ -1495,38 +1763,52 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 			 * list is processed.
 			 */
 			case -ENOSYS:
+				/* Splitting sleeps on the page lock */
+				migrate_pages_batch_move(&unmap_pages,
+						&dst_pages, put_new_page,
+						private, mode, reason,
+						&retry_pages, &ret_pages,
+						&stats);
+				nr_batched = 0;
 				/* THP migration is unsupported */
 				if (is_thp) {
-					nr_thp_failed++;
+					stats.nr_thp_failed++;
 					if (!try_split_thp(page, &thp_split_pages)) {
-						nr_thp_split++;
+						stats.nr_thp_split++;
 						break;
 					}
 				/* Hugetlb migration is unsupported */
-				} else if (!no_subpage_counting) {
-					nr_failed++;
+				} else if (!stats.no_subpage_counting) {
+					stats.nr_failed++;
 				}
 
-				nr_failed_pages += nr_subpages;
+				stats.nr_failed_pages += nr_subpages;
 				list_move_tail(&page->lru, &ret_pages);
 				break;
 			case -ENOMEM:
+				migrate_pages_batch_move(&unmap_pages,
+						&dst_pages, put_new_page,
+						private, mode, reason,
+						&retry_pages, &ret_pages,
+						&stats);
+				nr_batched = 0;
 				/*
 				 * When memory is low, don't bother to try to migrate
 				 * other pages, just exit.
 				 */
 				if (is_thp) {
-					nr_thp_failed++;
+					stats.nr_thp_failed++;
 					/* THP NUMA faulting doesn't split THP to retry. */
 					if (!nosplit && !try_split_thp(page, &thp_split_pages)) {
-						nr_thp_split++;
+						stats.nr_thp_split++;
 						break;
 					}
-				} else if (!no_subpage_counting) {
-					nr_failed++;
+				} else if (!stats.no_subpage_counting) {
+					stats.nr_failed++;
 				}
 
-				nr_failed_pages += nr_subpages + nr_retry_pages;
+				stats.nr_failed_pages += nr_subpages +
+							 stats.nr_retry_pages;
 				/*
 				 * There might be some subpages of fail-to-migrate THPs
 				 * left in thp_split_pages list. Move them back to migration
@@ -1534,20 +1816,21 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 				 * the caller otherwise the page refcnt will be leaked.
 				 */
 				list_splice_init(&thp_split_pages, from);
+				list_splice_init(&retry_pages, from);
 				/* nr_failed isn't updated for not used */
-				nr_thp_failed += thp_retry;
+				stats.nr_thp_failed += stats.thp_retry;
 				goto out;
 			case -EAGAIN:
 				if (is_thp)
-					thp_retry++;
-				else if (!no_subpage_counting)
-					retry++;
-				nr_retry_pages += nr_subpages;
+					stats.thp_retry++;
+				else if (!stats.no_subpage_counting)
+					stats.retry++;
+				stats.nr_retry_pages += nr_subpages;
 				break;
 			case MIGRATEPAGE_SUCCESS:
-				nr_succeeded += nr_subpages;
+				stats.nr_succeeded += nr_subpages;
 				if (is_thp)
-					nr_thp_succeeded++;
+					stats.nr_thp_succeeded++;
 				break;
 			default:
 				/*
@@ -1557,18 +1840,23 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 				 * retried in the next outer loop.
 				 */
 				if (is_thp)
-					nr_thp_failed++;
-				else if (!no_subpage_counting)
-					nr_failed++;
+					stats.nr_thp_failed++;
+				else if (!stats.no_subpage_counting)
+					stats.nr_failed++;
 
-				nr_failed_pages += nr_subpages;
+				stats.nr_failed_pages += nr_subpages;
 				break;
 			}
 		}
+		migrate_pages_batch_move(&unmap_pages, &dst_pages,
+					 put_new_page, private, mode, reason,
+					 &retry_pages, &ret_pages, &stats);
+		nr_batched = 0;
+		list_splice_tail_init(&retry_pages, from);
 	}
-	nr_failed += retry;
-	nr_thp_failed += thp_retry;
-	nr_failed_pages += nr_retry_pages;
+	stats.nr_failed += stats.retry;
+	stats.nr_thp_failed += stats.thp_retry;
+	stats.nr_failed_pages += stats.nr_retry_pages;
 	/*
 	 * Try to migrate subpages of fail-to-migrate THPs, no nr_failed
 	 * counting in this round, since all subpages of a THP is counted
@@ -1581,12 +1869,12 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 		 */
 		list_splice_init(from, &ret_pages);
 		list_splice_init(&thp_split_pages, from);
-		no_subpage_counting = true;
-		retry = 1;
+		stats.no_subpage_counting = true;
+		stats.retry = 1;
 		goto thp_subpage_migration;
 	}
 
-	rc = nr_failed + nr_thp_failed;
+	rc = stats.nr_failed + stats.nr_thp_failed;
 out:
 	/*
 	 * Put the permanent failure page back to migration list, they
@@ -1601,16 +1889,17 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 	if (list_empty(from))
 		rc = 0;
 
-	count_vm_events(PGMIGRATE_SUCCESS, nr_succeeded);
-	count_vm_events(PGMIGRATE_FAIL, nr_failed_pages);
-	count_vm_events(THP_MIGRATION_SUCCESS, nr_thp_succeeded);
-	count_vm_events(THP_MIGRATION_FAIL, nr_thp_failed);
-	count_vm_events(THP_MIGRATION_SPLIT, nr_thp_split);
-	trace_mm_migrate_pages(nr_succeeded, nr_failed_pages, nr_thp_succeeded,
-			       nr_thp_failed, nr_thp_split, mode, reason);
+	count_vm_events(PGMIGRATE_SUCCESS, stats.nr_succeeded);
+	count_vm_events(PGMIGRATE_FAIL, stats.nr_failed_pages);
+	count_vm_events(THP_MIGRATION_SUCCESS, stats.nr_thp_succeeded);
+	count_vm_events(THP_MIGRATION_FAIL, stats.nr_thp_failed);
+	count_vm_events(THP_MIGRATION_SPLIT, stats.nr_thp_split);
+	trace_mm_migrate_pages(stats.nr_succeeded, stats.nr_failed_pages,
+			       stats.nr_thp_succeeded, stats.nr_thp_failed,
+			       stats.nr_thp_split, mode, reason);
 
 	if (ret_succeeded)
-		*ret_succeeded = nr_succeeded;
+		*ret_succeeded = stats.nr_succeeded;
 
 	return rc;
 }
@@ -2239,3 +2528,79 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 }
 #endif /* CONFIG_NUMA_BALANCING */
 #endif /* CONFIG_NUMA */
+
+#ifdef CONFIG_SYSFS
+static ssize_t copy_threads_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", migrate_copy_threads);
+}
+
+static ssize_t copy_threads_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	unsigned int nr_threads;
+	int err;
+
+	err = kstrtouint(buf, 10, &nr_threads);
+	if (err)
+		return err;
+	if (nr_threads < 1 || nr_threads > MIGRATE_COPY_MAX_THREADS)
+		return -EINVAL;
+	if (nr_threads > 1 && !migrate_copy_wq)
+		return -ENOMEM;
+
+	WRITE_ONCE(migrate_copy_threads, nr_threads);
+	return count;
+}
+
+static struct kobj_attribute copy_threads_attr = __ATTR_RW(copy_threads);
+
+static struct attribute *migrate_attrs[] = {
+	&copy_threads_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group migrate_attr_group = {
+	.attrs = migrate_attrs,
+};
+
+static int __init migrate_init_sysfs(void)
+{
+	struct kobject *migrate_kobj;
+	int err;
+
+	migrate_kobj = kobject_create_and_add("migrate", mm_kobj);
+	if (!migrate_kobj) {
+		pr_err("failed to create migrate kobject\n");
+		return -ENOMEM;
+	}
+	err = sysfs_create_group(migrate_kobj, &migrate_attr_group);
+	if (err) {
+		pr_err("failed to register migrate group\n");
+		kobject_put(migrate_kobj);
+	}
+	return err;
+}
+#else
+static inline int migrate_init_sysfs(void)
+{
+	return 0;
+}
+#endif /* CONFIG_SYSFS */
+
+static int __init migrate_copy_init(void)
+{
+	/*
+	 * Not fatal: large folios are then copied by the migrating task.
+	 * kswapd, direct reclaim and compaction migrate folios and flush
+	 * the copy works, so they must be able to run without allocating
+	 * a new worker.
+	 */
+	migrate_copy_wq = alloc_workqueue("migrate_copy",
+					  WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+
+	return migrate_init_sysfs();
+}
+subsys_initcall(migrate_copy_init);
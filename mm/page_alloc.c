@@ -126,6 +126,8 @@ typedef int __bitwise fpi_t;
 /* prevent >1 _updater_ of zone percpu pageset ->high and ->batch fields */
 static DEFINE_MUTEX(pcp_batch_high_lock);
 #define MIN_PERCPU_PAGELIST_HIGH_FRACTION (8)
+/* Limit of pcp->alloc_factor, i.e. refill at most batch << 5 pages */
+#define PCP_BATCH_SCALE_MAX	5
 
 #if defined(CONFIG_SMP) || defined(CONFIG_PREEMPT_RT)
 /*
@@ -246,6 +248,7 @@ unsigned long totalreserve_pages __read_mostly;
 unsigned long totalcma_pages __read_mostly;
 
 int percpu_pagelist_high_fraction;
+int percpu_pagelist_adaptive;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 DEFINE_STATIC_KEY_MAYBE(CONFIG_INIT_ON_ALLOC_DEFAULT_ON, init_on_alloc);
 EXPORT_SYMBOL(init_on_alloc);
@@ -1544,6 +1547,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	/* Ensure requested pindex is drained first. */
 	pindex = pindex - 1;
 
+	pcp->buddy_batches++;
 	spin_lock_irqsave(&zone->lock, flags);
 	isolated_pageblocks = has_isolate_pageblock(zone);
 
@@ -3167,6 +3171,32 @@ void drain_zone_pages(struct zone *zone, struct per_cpu_pages *pcp)
 }
 #endif
 
+/*
+ * Called from vmstat refresh context to shrink a pcp->high that was grown
+ * in adaptive mode back towards pcp->high_min, and to return the pages
+ * above it to the buddy allocator. Returns true if pages were freed.
+ */
+bool decay_pcp_high(struct zone *zone, struct per_cpu_pages *pcp)
+{
+	int high_min, to_drain;
+
+	high_min = READ_ONCE(pcp->high_min);
+	if (READ_ONCE(pcp->high) <= high_min &&
+	    READ_ONCE(pcp->count) <= high_min)
+		return false;
+
+	spin_lock(&pcp->lock);
+	if (pcp->high > high_min)
+		WRITE_ONCE(pcp->high, max(pcp->high - (pcp->high >> 3), high_min));
+	to_drain = pcp->count - pcp->high;
+	if (to_drain > 0)
+		free_pcppages_bulk(zone, min(to_drain, READ_ONCE(pcp->batch) <<
+					     PCP_BATCH_SCALE_MAX), pcp, 0);
+	spin_unlock(&pcp->lock);
+
+	return to_drain > 0;
+}
+
 /*
  * Drain pcplists of the indicated processor and zone.
  */
@@ -3400,8 +3430,25 @@ static int nr_pcp_high(struct per_cpu_pages *pcp, struct zone *zone,
 	if (unlikely(!high || free_high))
 		return 0;
 
-	if (!test_bit(ZONE_RECLAIM_ACTIVE, &zone->flags))
+	if (!test_bit(ZONE_RECLAIM_ACTIVE, &zone->flags)) {
+		/*
+		 * In adaptive mode, a pcp that keeps filling up without any
+		 * allocation in between, typically because it frees pages
+		 * allocated on another CPU, is allowed to grow so that its
+		 * pages go back to the buddy allocator in fewer and larger
+		 * batches. decay_pcp_high() shrinks it again once idle.
+		 */
+		if (READ_ONCE(percpu_pagelist_adaptive) &&
+		    pcp->count >= high && pcp->free_factor) {
+			int high_max = READ_ONCE(pcp->high_max);
+
+			if (high < high_max) {
+				high = min(high + READ_ONCE(pcp->batch), high_max);
+				WRITE_ONCE(pcp->high, high);
+			}
+		}
 		return high;
+	}
 
 	/*
 	 * If reclaim is active, limit the number of pages that can be
@@ -3423,6 +3470,9 @@ static void free_unref_page_commit(struct zone *zone, struct per_cpu_pages *pcp,
 	list_add(&page->pcp_list, &pcp->lists[pindex]);
 	pcp->count += 1 << order;
 
+	/* See nr_pcp_alloc() where alloc_factor is increased on refill. */
+	pcp->alloc_factor >>= 1;
+
 	/*
 	 * As high-order pages other than THP's stored on PCP can contribute
 	 * to fragmentation, limit the number stored when PCP is heavily
@@ -3722,6 +3772,49 @@ struct page *rmqueue_buddy(struct zone *preferred_zone, struct zone *zone,
 	return page;
 }
 
+/*
+ * Number of pages to refill an empty pcp list with. In adaptive mode, a pcp
+ * that keeps running dry without frees in between refills in increasingly
+ * larger chunks, and its high watermark grows to hold them, so that the
+ * number of zone->lock acquisitions drops as the allocation rate goes up.
+ */
+static int nr_pcp_alloc(struct per_cpu_pages *pcp, unsigned int order)
+{
+	int batch = READ_ONCE(pcp->batch);
+
+	/*
+	 * Batch can be 1 for small zones or for boot pagesets which should
+	 * never store free pages as the pages may belong to arbitrary zones.
+	 */
+	if (batch <= 1)
+		return batch;
+
+	if (READ_ONCE(percpu_pagelist_adaptive)) {
+		int high = READ_ONCE(pcp->high);
+		int high_max = READ_ONCE(pcp->high_max);
+		int max_nr_alloc;
+
+		if (high < high_max) {
+			high = min(high + batch, high_max);
+			WRITE_ONCE(pcp->high, high);
+		}
+
+		/* Don't refill beyond what the list may hold */
+		max_nr_alloc = max(high - pcp->count - batch, batch);
+		batch <<= pcp->alloc_factor;
+		if (batch <= max_nr_alloc &&
+		    pcp->alloc_factor < PCP_BATCH_SCALE_MAX)
+			pcp->alloc_factor++;
+		batch = min(batch, max_nr_alloc);
+	}
+
+	/*
+	 * Scale batch relative to order if batch implies free pages can be
+	 * stored on the PCP.
+	 */
+	return max(batch >> order, 2);
+}
+
 /* Remove page from the per-cpu list, caller must protect the list */
 static inline
 struct page *__rmqueue_pcplist(struct zone *zone, unsigned int order,
@@ -3734,18 +3827,10 @@ struct page *__rmqueue_pcplist(struct zone *zone, unsigned int order,
 
 	do {
 		if (list_empty(list)) {
-			int batch = READ_ONCE(pcp->batch);
+			int batch = nr_pcp_alloc(pcp, order);
 			int alloced;
 
-			/*
-			 * Scale batch relative to order if batch implies
-			 * free pages can be stored on the PCP. Batch can
-			 * be 1 for small zones or for boot pagesets which
-			 * should never store free pages as the pages may
-			 * belong to arbitrary zones.
-			 */
-			if (batch > 1)
-				batch = max(batch >> order, 2);
+			pcp->buddy_batches++;
 			alloced = rmqueue_bulk(zone, order,
 					batch, list,
 					migratetype, alloc_flags);
@@ -7118,14 +7203,15 @@ static int zone_batchsize(struct zone *zone)
 #endif
 }
 
-static int zone_highsize(struct zone *zone, int batch, int cpu_online)
+static int zone_highsize(struct zone *zone, int batch, int cpu_online,
+			 int high_fraction)
 {
 #ifdef CONFIG_MMU
 	int high;
 	int nr_split_cpus;
 	unsigned long total_pages;
 
-	if (!percpu_pagelist_high_fraction) {
+	if (!high_fraction) {
 		/*
 		 * By default, the high value of the pcp is based on the zone
 		 * low watermark so that if they are full then background
@@ -7138,7 +7224,7 @@ static int zone_highsize(struct zone *zone, int batch, int cpu_online)
 		 * value is based on a fraction of the managed pages in the
 		 * zone.
 		 */
-		total_pages = zone_managed_pages(zone) / percpu_pagelist_high_fraction;
+		total_pages = zone_managed_pages(zone) / high_fraction;
 	}
 
 	/*
@@ -7183,9 +7269,11 @@ static int zone_highsize(struct zone *zone, int batch, int cpu_online)
  * exist).
  */
 static void pageset_update(struct per_cpu_pages *pcp, unsigned long high,
-		unsigned long batch)
+		unsigned long high_max, unsigned long batch)
 {
 	WRITE_ONCE(pcp->batch, batch);
+	WRITE_ONCE(pcp->high_min, high);
+	WRITE_ONCE(pcp->high_max, high_max);
 	WRITE_ONCE(pcp->high, high);
 }
 
@@ -7207,19 +7295,22 @@ static void per_cpu_pages_init(struct per_cpu_pages *pcp, struct per_cpu_zonesta
 	 * pageset yet.
 	 */
 	pcp->high = BOOT_PAGESET_HIGH;
+	pcp->high_min = BOOT_PAGESET_HIGH;
+	pcp->high_max = BOOT_PAGESET_HIGH;
 	pcp->batch = BOOT_PAGESET_BATCH;
 	pcp->free_factor = 0;
+	pcp->alloc_factor = 0;
 }
 
 static void __zone_set_pageset_high_and_batch(struct zone *zone, unsigned long high,
-		unsigned long batch)
+		unsigned long high_max, unsigned long batch)
 {
 	struct per_cpu_pages *pcp;
 	int cpu;
 
 	for_each_possible_cpu(cpu) {
 		pcp = per_cpu_ptr(zone->per_cpu_pageset, cpu);
-		pageset_update(pcp, high, batch);
+		pageset_update(pcp, high, high_max, batch);
 	}
 }
 
@@ -7229,19 +7320,27 @@ static void __zone_set_pageset_high_and_batch(struct zone *zone, unsigned long h
  */
 static void zone_set_pageset_high_and_batch(struct zone *zone, int cpu_online)
 {
-	int new_high, new_batch;
+	int new_high, new_high_max, new_batch;
 
 	new_batch = max(1, zone_batchsize(zone));
-	new_high = zone_highsize(zone, new_batch, cpu_online);
+	new_high = zone_highsize(zone, new_batch, cpu_online,
+				 percpu_pagelist_high_fraction);
+	/* adaptive mode may grow pcp->high up to the largest sysctl value */
+	new_high_max = zone_highsize(zone, new_batch, cpu_online,
+				     MIN_PERCPU_PAGELIST_HIGH_FRACTION);
+	new_high_max = max(new_high, new_high_max);
 
 	if (zone->pageset_high == new_high &&
+	    zone->pageset_high_max == new_high_max &&
 	    zone->pageset_batch == new_batch)
 		return;
 
 	zone->pageset_high = new_high;
+	zone->pageset_high_max = new_high_max;
 	zone->pageset_batch = new_batch;
 
-	__zone_set_pageset_high_and_batch(zone, new_high, new_batch);
+	__zone_set_pageset_high_and_batch(zone, new_high, new_high_max,
+					  new_batch);
 }
 
 void __meminit setup_zone_pageset(struct zone *zone)
@@ -7318,6 +7417,7 @@ static __meminit void zone_pcp_init(struct zone *zone)
 	zone->per_cpu_pageset = &boot_pageset;
 	zone->per_cpu_zonestats = &boot_zonestats;
 	zone->pageset_high = BOOT_PAGESET_HIGH;
+	zone->pageset_high_max = BOOT_PAGESET_HIGH;
 	zone->pageset_batch = BOOT_PAGESET_BATCH;
 
 	if (populated_zone(zone))
@@ -9027,6 +9127,35 @@ int percpu_pagelist_high_fraction_sysctl_handler(struct ctl_table *table,
 	return ret;
 }
 
+/*
+ * percpu_pagelist_adaptive - lets pcp->high and the refill batch of each
+ * per cpu pagelist follow its allocation and free rates, between the static
+ * high value and the one of the smallest percpu_pagelist_high_fraction.
+ */
+int percpu_pagelist_adaptive_sysctl_handler(struct ctl_table *table,
+		int write, void *buffer, size_t *length, loff_t *ppos)
+{
+	struct zone *zone;
+	int ret;
+
+	mutex_lock(&pcp_batch_high_lock);
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!write || ret < 0 || percpu_pagelist_adaptive)
+		goto out;
+
+	/*
+	 * Back to static high values. Pages above them are returned to the
+	 * buddy allocator by decay_pcp_high().
+	 */
+	for_each_populated_zone(zone)
+		__zone_set_pageset_high_and_batch(zone, zone->pageset_high,
+						  zone->pageset_high_max,
+						  zone->pageset_batch);
+out:
+	mutex_unlock(&pcp_batch_high_lock);
+	return ret;
+}
+
 #ifndef __HAVE_ARCH_RESERVED_KERNEL_PAGES
 /*
  * Returns the number of pages that arch has reserved but
@@ -9522,13 +9651,14 @@ EXPORT_SYMBOL(free_contig_range);
 void zone_pcp_disable(struct zone *zone)
 {
 	mutex_lock(&pcp_batch_high_lock);
-	__zone_set_pageset_high_and_batch(zone, 0, 1);
+	__zone_set_pageset_high_and_batch(zone, 0, 0, 1);
 	__drain_all_pages(zone, true);
 }
 
 void zone_pcp_enable(struct zone *zone)
 {
-	__zone_set_pageset_high_and_batch(zone, zone->pageset_high, zone->pageset_batch);
+	__zone_set_pageset_high_and_batch(zone, zone->pageset_high,
+					  zone->pageset_high_max, zone->pageset_batch);
 	mutex_unlock(&pcp_batch_high_lock);
 }
 
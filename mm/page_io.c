@@ -470,11 +470,22 @@ int swap_readpage(struct page *page, bool synchronous,
 	}
 	delayacct_swapin_start();
 
-	if (frontswap_load(page) == 0) {
+	ret = frontswap_load(page);
+	if (ret == 0) {
 		SetPageUptodate(page);
 		unlock_page(page);
 		goto out;
 	}
+	if (ret == -EAGAIN) {
+		/*
+		 * Part of a large folio is only in frontswap: the swap device
+		 * does not hold all of it either, leave it !uptodate for the
+		 * caller to fall back to order-0 swapin.
+		 */
+		unlock_page(page);
+		goto out;
+	}
+	ret = 0;
 
 	if (data_race(sis->flags & SWP_FS_OPS)) {
 		swap_readpage_fs(page, plug);
@@ -502,7 +513,7 @@ int swap_readpage(struct page *page, bool synchronous,
 		get_task_struct(current);
 		bio->bi_private = current;
 	}
-	count_vm_event(PSWPIN);
+	count_vm_events(PSWPIN, thp_nr_pages(page));
 	bio_get(bio);
 	submit_bio(bio);
 	while (synchronous) {
@@ -153,6 +153,9 @@ static void read_pages(struct readahead_control *rac)
 	if (!readahead_count(rac))
 		return;
 
+	bdi_ra_stat_add(inode_to_bdi(rac->mapping->host), BDI_RA_PAGES,
+			readahead_count(rac));
+
 	if (unlikely(rac->_workingset))
 		psi_memstall_enter(&rac->_pflags);
 	blk_start_plug(&plug);
@@ -401,6 +404,11 @@ static unsigned long get_next_ra_size(struct file_ra_state *ra,
  * for sequential patterns. Hence interleaved reads might be served as
  * sequential ones.
  *
+ * Reads that are not sequential are not necessarily random: prev_miss and
+ * stride track the distance between such misses, and once a few of them in
+ * a row are the same distance apart - forward strides, or a file read
+ * backwards - the next requests along the stride are read ahead as well.
+ *
  * There is a special-case: if the first page which the application tries to
  * read happens to be the first page of the file, it is assumed that a linear
  * read is about to happen and the window is immediately set to the initial size
@@ -564,6 +572,100 @@ void page_cache_ra_order(struct readahead_control *ractl,
 	do_page_cache_ra(ractl, ra->size, ra->async_size);
 }
 
+/*
+ * Misses further apart than this many readahead windows are not worth
+ * treating as a stride.
+ */
+#define RA_STRIDE_MAX_WINDOWS	64
+/* Misses in a row at the same stride before we start reading ahead */
+#define RA_STRIDE_MIN_HITS	2
+#define RA_STRIDE_MAX_HITS	8
+
+/*
+ * Track the distance between non-sequential misses.  Returns true once
+ * enough of them in a row were the same distance apart, forwards or
+ * backwards, for the pattern to be worth reading ahead.
+ */
+static bool ra_detect_stride(struct file_ra_state *ra, pgoff_t index,
+			     unsigned long max_pages)
+{
+	long delta = (long)(index - ra->prev_miss);
+
+	ra->prev_miss = index;
+	if (delta && delta == ra->stride) {
+		if (ra->stride_hits < RA_STRIDE_MAX_HITS)
+			ra->stride_hits++;
+		return ra->stride_hits >= RA_STRIDE_MIN_HITS;
+	}
+
+	if ((unsigned long)abs(delta) > max_pages * RA_STRIDE_MAX_WINDOWS)
+		delta = 0;
+	ra->stride = delta;
+	ra->stride_hits = 0;
+	return false;
+}
+
+/*
+ * Read a window sized for one request at the given position, in folios
+ * as large as the request allows.
+ */
+static void ra_stride_chunk(struct readahead_control *ractl,
+		struct file_ra_state *ra, pgoff_t start, unsigned long nr)
+{
+	ra->start = start;
+	ra->size = nr;
+	ra->async_size = 0;
+	ractl->_index = start;
+	page_cache_ra_order(ractl, ra, nr > 1 ? ilog2(nr) - 1 : 0);
+}
+
+/*
+ * Read ahead along a confirmed stride.  The depth doubles with every
+ * miss that keeps to the stride, bounded by the readahead window.  A
+ * stride no larger than the request is a backward scan and is read as
+ * one contiguous window below @index; larger strides get one window per
+ * expected request.  ->prev_miss is moved to the last request covered,
+ * so that the next miss still lines up with the stride.
+ */
+static void ra_stride_readahead(struct readahead_control *ractl,
+		struct file_ra_state *ra, unsigned long req_size,
+		unsigned long max_pages)
+{
+	struct backing_dev_info *bdi = inode_to_bdi(ractl->mapping->host);
+	pgoff_t index = readahead_index(ractl);
+	unsigned long stride = abs(ra->stride);
+	unsigned long depth = 1UL << ra->stride_hits;
+	unsigned long k;
+
+	if (stride <= req_size) {
+		unsigned long span = req_size + depth * stride;
+		pgoff_t start;
+
+		span = min(span, max(max_pages, req_size));
+		start = index + req_size > span ? index + req_size - span : 0;
+		ra->prev_miss = index - (index - start) / stride * stride;
+		bdi_ra_stat_inc(bdi, BDI_RA_REVERSE);
+		ra_stride_chunk(ractl, ra, start, index + req_size - start);
+		return;
+	}
+
+	depth = min(depth, max(max_pages / req_size, 1UL) - 1);
+	bdi_ra_stat_inc(bdi, ra->stride > 0 ? BDI_RA_STRIDE : BDI_RA_REVERSE);
+	for (k = 0; k <= depth; k++) {
+		pgoff_t pos;
+
+		if (ra->stride > 0) {
+			pos = index + k * stride;
+		} else {
+			if (k * stride > index)
+				break;
+			pos = index - k * stride;
+		}
+		ra->prev_miss = pos;
+		ra_stride_chunk(ractl, ra, pos, req_size);
+	}
+}
+
 /*
  * A minimal readahead algorithm for trivial sequential/random reads.
  */
@@ -585,6 +687,8 @@ static void ondemand_readahead(struct readahead_control *ractl,
 	if (req_size > max_pages && bdi->io_pages > max_pages)
 		max_pages = min(req_size, bdi->io_pages);
 
+	bdi_ra_stat_inc(bdi, folio ? BDI_RA_HIT : BDI_RA_MISS);
+
 	/*
 	 * start of file
 	 */
@@ -621,6 +725,7 @@ static void ondemand_readahead(struct readahead_control *ractl,
 		if (!start || start - index > max_pages)
 			return;
 
+		bdi_ra_stat_inc(bdi, BDI_RA_INTERLEAVED);
 		ra->start = start;
 		ra->size = start - index;	/* old async_size */
 		ra->size += req_size;
@@ -652,6 +757,15 @@ static void ondemand_readahead(struct readahead_control *ractl,
 			max_pages))
 		goto readit;
 
+	/*
+	 * Misses at a constant distance from each other, forwards or
+	 * backwards: read ahead along the stride.
+	 */
+	if (ra_detect_stride(ra, index, max_pages)) {
+		ra_stride_readahead(ractl, ra, req_size, max_pages);
+		return;
+	}
+
 	/*
 	 * standalone, small random read
 	 * Read as is, and do not pollute the readahead state.
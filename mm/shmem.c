@@ -115,11 +115,13 @@ struct shmem_options {
 	umode_t mode;
 	bool full_inums;
 	int huge;
+	unsigned int huge_order;
 	int seen;
 #define SHMEM_SEEN_BLOCKS 1
 #define SHMEM_SEEN_INODES 2
 #define SHMEM_SEEN_HUGE 4
 #define SHMEM_SEEN_INUMS 8
+#define SHMEM_SEEN_HUGE_ORDER 16
 };
 
 #ifdef CONFIG_TMPFS
@@ -462,11 +464,14 @@ static bool shmem_confirm_swap(struct address_space *mapping,
 
 static int shmem_huge __read_mostly = SHMEM_HUGE_NEVER;
 
-bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
-		   pgoff_t index, bool shmem_huge_force)
+/*
+ * Whether a large folio of @nr pages may be allocated at @index, for a
+ * file that is (or is about to become) @i_size bytes long.
+ */
+static bool __shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
+			    pgoff_t index, bool shmem_huge_force,
+			    loff_t i_size, unsigned long nr)
 {
-	loff_t i_size;
-
 	if (!S_ISREG(inode->i_mode))
 		return false;
 	if (vma && ((vma->vm_flags & VM_NOHUGEPAGE) ||
@@ -481,8 +486,8 @@ bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
 	case SHMEM_HUGE_ALWAYS:
 		return true;
 	case SHMEM_HUGE_WITHIN_SIZE:
-		index = round_up(index + 1, HPAGE_PMD_NR);
-		i_size = round_up(i_size_read(inode), PAGE_SIZE);
+		index = round_up(index + 1, nr);
+		i_size = round_up(i_size, PAGE_SIZE);
 		if (i_size >> PAGE_SHIFT >= index)
 			return true;
 		fallthrough;
@@ -495,6 +500,58 @@ bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
 	}
 }
 
+bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
+		   pgoff_t index, bool shmem_huge_force)
+{
+	return __shmem_is_huge(vma, inode, index, shmem_huge_force,
+			       i_size_read(inode), HPAGE_PMD_NR);
+}
+
+/*
+ * Order of the folio to allocate at @index, 0 for a small page.
+ *
+ * By default a large folio is always PMD-sized.  With the huge_order=
+ * mount option it is sized to the access instead: the largest order up to
+ * huge_order whose naturally aligned range around @index ends within the
+ * write in progress, or within the fault-around window for a fault, and
+ * never past the end of the file.
+ */
+static unsigned int shmem_huge_order(struct inode *inode, pgoff_t index,
+				     enum sgp_type sgp,
+				     struct vm_area_struct *vma)
+{
+	unsigned int order = SHMEM_SB(inode->i_sb)->huge_order;
+	loff_t size = i_size_read(inode);
+	pgoff_t end;
+
+	if (!order)
+		return shmem_is_huge(vma, inode, index, false) ?
+			HPAGE_PMD_ORDER : 0;
+
+	if (sgp == SGP_WRITE)
+		size = max(size, READ_ONCE(SHMEM_I(inode)->write_end));
+	end = DIV_ROUND_UP(size, PAGE_SIZE);
+	if (vma) {
+		unsigned long nr = max(fault_around_bytes >> PAGE_SHIFT, 1UL);
+
+		end = min(end, round_down(index, nr) + nr);
+		end = min(end, vma->vm_pgoff + vma_pages(vma));
+	}
+
+	for (; order; order--) {
+		/* order-1 folios cannot go on the deferred split list */
+		if (order == 1)
+			continue;
+		if (round_down(index, 1UL << order) + (1UL << order) <= end)
+			break;
+	}
+	if (!order ||
+	    !__shmem_is_huge(vma, inode, index, false, size, 1UL << order))
+		return 0;
+
+	return order;
+}
+
 #if defined(CONFIG_SYSFS)
 static int shmem_parse_huge(const char *str)
 {
@@ -601,8 +658,11 @@ static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 		if (!folio)
 			goto drop;
 
-		/* No huge page at the end of the file: nothing to split */
-		if (!folio_test_large(folio)) {
+		/*
+		 * No PMD-size folio at the end of the file: nothing to split,
+		 * smaller large folios are never allocated beyond i_size.
+		 */
+		if (!folio_test_pmd_mappable(folio)) {
 			folio_put(folio);
 			goto drop;
 		}
@@ -676,6 +736,13 @@ bool shmem_is_huge(struct vm_area_struct *vma, struct inode *inode,
 	return false;
 }
 
+static unsigned int shmem_huge_order(struct inode *inode, pgoff_t index,
+				     enum sgp_type sgp,
+				     struct vm_area_struct *vma)
+{
+	return 0;
+}
+
 static unsigned long shmem_unused_huge_shrink(struct shmem_sb_info *sbinfo,
 		struct shrink_control *sc, unsigned long nr_to_split)
 {
@@ -1559,22 +1626,24 @@ static gfp_t limit_gfp_mask(gfp_t huge_gfp, gfp_t limit_gfp)
 }
 
 static struct folio *shmem_alloc_hugefolio(gfp_t gfp,
-		struct shmem_inode_info *info, pgoff_t index)
+		struct shmem_inode_info *info, pgoff_t index, unsigned int order)
 {
 	struct vm_area_struct pvma;
 	struct address_space *mapping = info->vfs_inode.i_mapping;
+	unsigned long nr = 1UL << order;
 	pgoff_t hindex;
 	struct folio *folio;
 
-	hindex = round_down(index, HPAGE_PMD_NR);
-	if (xa_find(&mapping->i_pages, &hindex, hindex + HPAGE_PMD_NR - 1,
-								XA_PRESENT))
+	hindex = round_down(index, nr);
+	if (xa_find(&mapping->i_pages, &hindex, hindex + nr - 1, XA_PRESENT))
 		return NULL;
 
 	shmem_pseudo_vma_init(&pvma, info, hindex);
-	folio = vma_alloc_folio(gfp, HPAGE_PMD_ORDER, &pvma, 0, true);
+	folio = vma_alloc_folio(gfp, order, &pvma, 0, true);
 	shmem_pseudo_vma_destroy(&pvma);
-	if (!folio)
+	if (order < HPAGE_PMD_ORDER)
+		count_vm_event(folio ? SHMEM_MTHP_ALLOC : SHMEM_MTHP_FALLBACK);
+	else if (!folio)
 		count_vm_event(THP_FILE_FALLBACK);
 	return folio;
 }
@@ -1593,7 +1662,7 @@ static struct folio *shmem_alloc_folio(gfp_t gfp,
 }
 
 static struct folio *shmem_alloc_and_acct_folio(gfp_t gfp, struct inode *inode,
-		pgoff_t index, bool huge)
+		pgoff_t index, unsigned int order)
 {
 	struct shmem_inode_info *info = SHMEM_I(inode);
 	struct folio *folio;
@@ -1601,14 +1670,14 @@ static struct folio *shmem_alloc_and_acct_folio(gfp_t gfp, struct inode *inode,
 	int err = -ENOSPC;
 
 	if (!IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE))
-		huge = false;
-	nr = huge ? HPAGE_PMD_NR : 1;
+		order = 0;
+	nr = 1 << order;
 
 	if (!shmem_inode_acct_block(inode, nr))
 		goto failed;
 
-	if (huge)
-		folio = shmem_alloc_hugefolio(gfp, info, index);
+	if (order)
+		folio = shmem_alloc_hugefolio(gfp, info, index, order);
 	else
 		folio = shmem_alloc_folio(gfp, info, index);
 	if (folio) {
@@ -1862,6 +1931,7 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 	struct mm_struct *charge_mm;
 	struct folio *folio;
 	pgoff_t hindex = index;
+	unsigned int order;
 	gfp_t huge_gfp;
 	int error;
 	int once = 0;
@@ -1930,15 +2000,16 @@ static int shmem_get_folio_gfp(struct inode *inode, pgoff_t index,
 		return 0;
 	}
 
-	if (!shmem_is_huge(vma, inode, index, false))
+	order = shmem_huge_order(inode, index, sgp, vma);
+	if (!order)
 		goto alloc_nohuge;
 
 	huge_gfp = vma_thp_gfp_mask(vma);
 	huge_gfp = limit_gfp_mask(huge_gfp, gfp);
-	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, true);
+	folio = shmem_alloc_and_acct_folio(huge_gfp, inode, index, order);
 	if (IS_ERR(folio)) {
 alloc_nohuge:
-		folio = shmem_alloc_and_acct_folio(gfp, inode, index, false);
+		folio = shmem_alloc_and_acct_folio(gfp, inode, index, 0);
 	}
 	if (IS_ERR(folio)) {
 		int retry = 5;
@@ -2577,21 +2648,21 @@ shmem_write_end(struct file *file, struct address_space *mapping,
 			loff_t pos, unsigned len, unsigned copied,
 			struct page *page, void *fsdata)
 {
+	struct folio *folio = page_folio(page);
 	struct inode *inode = mapping->host;
 
 	if (pos + copied > inode->i_size)
 		i_size_write(inode, pos + copied);
 
-	if (!PageUptodate(page)) {
-		struct page *head = compound_head(page);
-		if (PageTransCompound(page)) {
-			int i;
+	if (!folio_test_uptodate(folio)) {
+		if (folio_test_large(folio)) {
+			long i, n = folio_nr_pages(folio);
 
-			for (i = 0; i < HPAGE_PMD_NR; i++) {
-				if (head + i == page)
+			for (i = 0; i < n; i++) {
+				if (folio_page(folio, i) == page)
 					continue;
-				clear_highpage(head + i);
-				flush_dcache_page(head + i);
+				clear_highpage(folio_page(folio, i));
+				flush_dcache_page(folio_page(folio, i));
 			}
 		}
 		if (copied < PAGE_SIZE) {
@@ -2599,7 +2670,7 @@ shmem_write_end(struct file *file, struct address_space *mapping,
 			zero_user_segments(page, 0, from,
 					from + copied, PAGE_SIZE);
 		}
-		SetPageUptodate(head);
+		folio_mark_uptodate(folio);
 	}
 	set_page_dirty(page);
 	unlock_page(page);
@@ -2727,6 +2798,31 @@ static ssize_t shmem_file_read_iter(struct kiocb *iocb, struct iov_iter *to)
 	return retval ? retval : error;
 }
 
+/*
+ * As generic_file_write_iter(), but publish the end of the write to
+ * shmem_huge_order() while i_rwsem is held, so that large folios can be
+ * sized to the whole write rather than to the page being copied.
+ */
+static ssize_t shmem_file_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct inode *inode = file_inode(iocb->ki_filp);
+	struct shmem_inode_info *info = SHMEM_I(inode);
+	ssize_t ret;
+
+	inode_lock(inode);
+	ret = generic_write_checks(iocb, from);
+	if (ret > 0) {
+		WRITE_ONCE(info->write_end, iocb->ki_pos + ret);
+		ret = __generic_file_write_iter(iocb, from);
+		WRITE_ONCE(info->write_end, 0);
+	}
+	inode_unlock(inode);
+
+	if (ret > 0)
+		ret = generic_write_sync(iocb, ret);
+	return ret;
+}
+
 static loff_t shmem_file_llseek(struct file *file, loff_t offset, int whence)
 {
 	struct address_space *mapping = file->f_mapping;
@@ -3463,6 +3559,7 @@ static const struct export_operations shmem_export_ops = {
 enum shmem_param {
 	Opt_gid,
 	Opt_huge,
+	Opt_huge_order,
 	Opt_mode,
 	Opt_mpol,
 	Opt_nr_blocks,
@@ -3484,6 +3581,7 @@ static const struct constant_table shmem_param_enums_huge[] = {
 const struct fs_parameter_spec shmem_fs_parameters[] = {
 	fsparam_u32   ("gid",		Opt_gid),
 	fsparam_enum  ("huge",		Opt_huge,  shmem_param_enums_huge),
+	fsparam_u32   ("huge_order",	Opt_huge_order),
 	fsparam_u32oct("mode",		Opt_mode),
 	fsparam_string("mpol",		Opt_mpol),
 	fsparam_string("nr_blocks",	Opt_nr_blocks),
@@ -3574,6 +3672,17 @@ static int shmem_parse_one(struct fs_context *fc, struct fs_parameter *param)
 			goto unsupported_parameter;
 		ctx->seen |= SHMEM_SEEN_HUGE;
 		break;
+	case Opt_huge_order:
+		if (!(IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) &&
+		      has_transparent_hugepage()))
+			goto unsupported_parameter;
+		ctx->huge_order = result.uint_32;
+		/* order-1 folios cannot be split, see shmem_huge_order() */
+		if (ctx->huge_order == 1 ||
+		    ctx->huge_order > HPAGE_PMD_ORDER)
+			goto bad_value;
+		ctx->seen |= SHMEM_SEEN_HUGE_ORDER;
+		break;
 	case Opt_mpol:
 		if (IS_ENABLED(CONFIG_NUMA)) {
 			mpol_put(ctx->mpol);
@@ -3696,6 +3805,8 @@ static int shmem_reconfigure(struct fs_context *fc)
 
 	if (ctx->seen & SHMEM_SEEN_HUGE)
 		sbinfo->huge = ctx->huge;
+	if (ctx->seen & SHMEM_SEEN_HUGE_ORDER)
+		sbinfo->huge_order = ctx->huge_order;
 	if (ctx->seen & SHMEM_SEEN_INUMS)
 		sbinfo->full_inums = ctx->full_inums;
 	if (ctx->seen & SHMEM_SEEN_BLOCKS)
@@ -3765,6 +3876,8 @@ static int shmem_show_options(struct seq_file *seq, struct dentry *root)
 	/* Rightly or wrongly, show huge mount option unmasked by shmem_huge */
 	if (sbinfo->huge)
 		seq_printf(seq, ",huge=%s", shmem_format_huge(sbinfo->huge));
+	if (sbinfo->huge_order)
+		seq_printf(seq, ",huge_order=%u", sbinfo->huge_order);
 #endif
 	shmem_show_mpol(seq, sbinfo->mpol);
 	return 0;
@@ -3830,6 +3943,7 @@ static int shmem_fill_super(struct super_block *sb, struct fs_context *fc)
 	sbinfo->full_inums = ctx->full_inums;
 	sbinfo->mode = ctx->mode;
 	sbinfo->huge = ctx->huge;
+	sbinfo->huge_order = ctx->huge_order;
 	sbinfo->mpol = ctx->mpol;
 	ctx->mpol = NULL;
 
@@ -3962,7 +4076,7 @@ static const struct file_operations shmem_file_operations = {
 #ifdef CONFIG_TMPFS
 	.llseek		= shmem_file_llseek,
 	.read_iter	= shmem_file_read_iter,
-	.write_iter	= generic_file_write_iter,
+	.write_iter	= shmem_file_write_iter,
 	.fsync		= noop_fsync,
 	.splice_read	= generic_file_splice_read,
 	.splice_write	= iter_file_splice_write,
@@ -2672,6 +2672,11 @@ static inline void unfreeze_partials_cpu(struct kmem_cache *s,
 
 #endif	/* CONFIG_SLUB_CPU_PARTIAL */
 
+static void *alloc_from_sheaf(struct kmem_cache *s, gfp_t gfpflags);
+static void free_to_sheaf(struct kmem_cache *s, void *object);
+static void flush_cpu_sheaf(struct kmem_cache *s);
+static void __flush_cpu_sheaf(struct kmem_cache *s, int cpu);
+
 static inline void flush_slab(struct kmem_cache *s, struct kmem_cache_cpu *c)
 {
 	unsigned long flags;
@@ -2733,6 +2738,10 @@ static void flush_cpu_slab(struct work_struct *w)
 	sfw = container_of(w, struct slub_flush_work, work);
 
 	s = sfw->s;
+
+	/* Objects in the sheaf may go back to the cpu slab, so flush it first */
+	flush_cpu_sheaf(s);
+
 	c = this_cpu_ptr(s->cpu_slab);
 
 	if (c->slab)
@@ -2745,6 +2754,9 @@ static bool has_cpu_slab(int cpu, struct kmem_cache *s)
 {
 	struct kmem_cache_cpu *c = per_cpu_ptr(s->cpu_slab, cpu);
 
+	if (s->cpu_sheaves && per_cpu_ptr(s->cpu_sheaves, cpu)->size)
+		return true;
+
 	return c->slab || slub_percpu_partial(c);
 }
 
@@ -2797,8 +2809,10 @@ static int slub_cpu_dead(unsigned int cpu)
 	struct kmem_cache *s;
 
 	mutex_lock(&slab_mutex);
-	list_for_each_entry(s, &slab_caches, list)
+	list_for_each_entry(s, &slab_caches, list) {
+		__flush_cpu_sheaf(s, cpu);
 		__flush_cpu_slab(s, cpu);
+	}
 	mutex_unlock(&slab_mutex);
 	return 0;
 }
@@ -3323,6 +3337,11 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s, struct list_l
 	if (unlikely(object))
 		goto out;
 
+	if (s->cpu_sheaves && node == NUMA_NO_NODE) {
+		object = alloc_from_sheaf(s, gfpflags);
+		goto wipe;
+	}
+
 redo:
 	/*
 	 * Must read kmem_cache cpu data via this cpu ptr. Preemption is
@@ -3391,6 +3410,7 @@ static __always_inline void *slab_alloc_node(struct kmem_cache *s, struct list_l
 		stat(s, ALLOC_FASTPATH);
 	}
 
+wipe:
 	maybe_wipe_obj_freeptr(s, object);
 	init = slab_want_init_on_alloc(gfpflags, s);
 
@@ -3658,8 +3678,16 @@ static __always_inline void slab_free(struct kmem_cache *s, struct slab *slab,
 	 * With KASAN enabled slab_free_freelist_hook modifies the freelist
 	 * to remove objects, whose reuse must be delayed.
 	 */
-	if (slab_free_freelist_hook(s, &head, &tail, &cnt))
-		do_slab_free(s, slab, head, tail, cnt, addr);
+	if (!slab_free_freelist_hook(s, &head, &tail, &cnt))
+		return;
+
+	if (s->cpu_sheaves && cnt == 1 && !slab_test_pfmemalloc(slab) &&
+	    !is_kfence_address(head)) {
+		free_to_sheaf(s, head);
+		return;
+	}
+
+	do_slab_free(s, slab, head, tail, cnt, addr);
 }
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -3862,6 +3890,238 @@ int kmem_cache_alloc_bulk(struct kmem_cache *s, gfp_t flags, size_t size,
 }
 EXPORT_SYMBOL(kmem_cache_alloc_bulk);
 
+/*
+ * Per cpu sheaves.
+ *
+ * A sheaf is a small per cpu array of free objects that sits in front of the
+ * cpu slab. Unlike the cpu freelist it can hold objects from any slab, so
+ * frees of objects that do not belong to the cpu slab are absorbed without
+ * touching the slab or the node list_lock. Objects only enter or leave the
+ * sheaf after the alloc/free hooks have run, so sheaves are invisible to
+ * memcg accounting, init_on_alloc/free and KASAN.
+ *
+ * An empty sheaf is refilled with half its capacity from the cpu slab, a full
+ * sheaf returns its oldest half to the slabs as detached freelists.
+ */
+#define SHEAF_CAPACITY_MAX	32
+
+static unsigned int calculate_sheaf_capacity(struct kmem_cache *s)
+{
+	if (s->size <= 256)
+		return SHEAF_CAPACITY_MAX;
+	if (s->size <= 1024)
+		return SHEAF_CAPACITY_MAX / 2;
+	return SHEAF_CAPACITY_MAX / 4;
+}
+
+/*
+ * Take up to @count objects for the sheaf from the cpu slab, falling back to
+ * ___slab_alloc() like kmem_cache_alloc_bulk() does, but without the hooks.
+ */
+static unsigned int sheaf_alloc_objects(struct kmem_cache *s, gfp_t gfpflags,
+					void **p, unsigned int count)
+{
+	struct kmem_cache_cpu *c;
+	unsigned long flags;
+	unsigned int i = 0;
+
+	c = slub_get_cpu_ptr(s->cpu_slab);
+	local_lock_irqsave(&s->cpu_slab->lock, flags);
+
+	while (i < count) {
+		void *object = c->freelist;
+
+		if (unlikely(!object)) {
+			/* See the comment in kmem_cache_alloc_bulk() */
+			c->tid = next_tid(c->tid);
+
+			local_unlock_irqrestore(&s->cpu_slab->lock, flags);
+
+			object = ___slab_alloc(s, gfpflags, NUMA_NO_NODE,
+					       _RET_IP_, c, s->object_size);
+			if (unlikely(!object))
+				goto out;
+
+			c = this_cpu_ptr(s->cpu_slab);
+			p[i++] = object;
+
+			local_lock_irqsave(&s->cpu_slab->lock, flags);
+			continue;
+		}
+		c->freelist = get_freepointer(s, object);
+		p[i++] = object;
+	}
+	c->tid = next_tid(c->tid);
+	local_unlock_irqrestore(&s->cpu_slab->lock, flags);
+out:
+	slub_put_cpu_ptr(s->cpu_slab);
+	return i;
+}
+
+/* Return objects that already went through the free hooks to their slabs */
+static void sheaf_free_objects(struct kmem_cache *s, void **p, unsigned int nr)
+{
+	while (nr) {
+		struct detached_freelist df;
+
+		nr = build_detached_freelist(s, nr, p, &df);
+		do_slab_free(df.s, df.slab, df.freelist, df.tail, df.cnt,
+			     _RET_IP_);
+	}
+}
+
+static void *alloc_from_sheaf(struct kmem_cache *s, gfp_t gfpflags)
+{
+	void *objects[SHEAF_CAPACITY_MAX / 2];
+	struct slub_percpu_sheaf *sheaf;
+	unsigned int count, nr;
+	unsigned long flags;
+	void *object;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	if (likely(sheaf->size)) {
+		object = sheaf->objects[--sheaf->size];
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+		stat(s, SHEAF_ALLOC);
+		return object;
+	}
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	/*
+	 * Objects from pfmemalloc slabs must not be stashed for allocations
+	 * that are not entitled to the reserves.
+	 */
+	count = s->sheaf_capacity / 2;
+	if (unlikely(gfp_pfmemalloc_allowed(gfpflags)))
+		count = 1;
+
+	count = sheaf_alloc_objects(s, gfpflags, objects, count);
+	if (unlikely(!count))
+		return NULL;
+	object = objects[--count];
+	if (!count)
+		return object;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	nr = min(count, s->sheaf_capacity - sheaf->size);
+	count -= nr;
+	memcpy(&sheaf->objects[sheaf->size], &objects[count],
+	       nr * sizeof(void *));
+	sheaf->size += nr;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+	stat(s, SHEAF_REFILL);
+
+	/* Raced with frees on this cpu or were migrated to a fuller sheaf */
+	if (unlikely(count))
+		sheaf_free_objects(s, objects, count);
+
+	return object;
+}
+
+static void free_to_sheaf(struct kmem_cache *s, void *object)
+{
+	void *objects[SHEAF_CAPACITY_MAX / 2];
+	struct slub_percpu_sheaf *sheaf;
+	unsigned long flags;
+	unsigned int nr;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	if (likely(sheaf->size < s->sheaf_capacity)) {
+		sheaf->objects[sheaf->size++] = object;
+		local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+		stat(s, SHEAF_FREE);
+		return;
+	}
+
+	/* Keep the recently freed, cache hot half and flush the rest */
+	nr = s->sheaf_capacity / 2;
+	memcpy(objects, sheaf->objects, nr * sizeof(void *));
+	memmove(sheaf->objects, &sheaf->objects[nr],
+		(sheaf->size - nr) * sizeof(void *));
+	sheaf->size -= nr;
+	sheaf->objects[sheaf->size++] = object;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+	stat(s, SHEAF_FREE);
+	stat(s, SHEAF_FLUSH);
+
+	sheaf_free_objects(s, objects, nr);
+}
+
+/* Empty the sheaf of the current cpu */
+static void flush_cpu_sheaf(struct kmem_cache *s)
+{
+	void *objects[SHEAF_CAPACITY_MAX];
+	struct slub_percpu_sheaf *sheaf;
+	unsigned long flags;
+	unsigned int nr;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	local_lock_irqsave(&s->cpu_sheaves->lock, flags);
+	sheaf = this_cpu_ptr(s->cpu_sheaves);
+	nr = sheaf->size;
+	memcpy(objects, sheaf->objects, nr * sizeof(void *));
+	sheaf->size = 0;
+	local_unlock_irqrestore(&s->cpu_sheaves->lock, flags);
+
+	if (nr) {
+		sheaf_free_objects(s, objects, nr);
+		stat(s, SHEAF_FLUSH);
+	}
+}
+
+/* Empty the sheaf of a cpu that went offline */
+static void __flush_cpu_sheaf(struct kmem_cache *s, int cpu)
+{
+	struct slub_percpu_sheaf *sheaf;
+
+	if (!s->cpu_sheaves)
+		return;
+
+	sheaf = per_cpu_ptr(s->cpu_sheaves, cpu);
+	if (sheaf->size) {
+		sheaf_free_objects(s, sheaf->objects, sheaf->size);
+		sheaf->size = 0;
+		stat(s, SHEAF_FLUSH);
+	}
+}
+
+static void alloc_kmem_cache_sheaves(struct kmem_cache *s)
+{
+	unsigned int capacity;
+	int cpu;
+
+	if (!(s->flags & SLAB_PERCPU_SHEAVES))
+		return;
+
+	/* Debugging needs to see every object on its way in and out */
+	if (kmem_cache_debug(s))
+		goto disable;
+
+	capacity = calculate_sheaf_capacity(s);
+	s->cpu_sheaves = __alloc_percpu(sizeof(struct slub_percpu_sheaf) +
+					capacity * sizeof(void *),
+					sizeof(void *));
+	if (!s->cpu_sheaves)
+		goto disable;
+
+	for_each_possible_cpu(cpu) {
+		struct slub_percpu_sheaf *sheaf = per_cpu_ptr(s->cpu_sheaves, cpu);
+
+		local_lock_init(&sheaf->lock);
+		sheaf->size = 0;
+	}
+	s->sheaf_capacity = capacity;
+	return;
+
+disable:
+	s->flags &= ~SLAB_PERCPU_SHEAVES;
+}
+
 
 /*
  * Object placement in a slab is made very easy because we always start at
@@ -4095,6 +4355,7 @@ static void free_kmem_cache_nodes(struct kmem_cache *s)
 void __kmem_cache_release(struct kmem_cache *s)
 {
 	cache_random_seq_destroy(s);
+	free_percpu(s->cpu_sheaves);
 	free_percpu(s->cpu_slab);
 	free_kmem_cache_nodes(s);
 }
@@ -4348,8 +4609,11 @@ static int kmem_cache_open(struct kmem_cache *s, slab_flags_t flags)
 	if (!init_kmem_cache_nodes(s))
 		goto error;
 
-	if (alloc_kmem_cache_cpus(s))
+	if (alloc_kmem_cache_cpus(s)) {
+		/* Sheaves are optional, the cache works without them */
+		alloc_kmem_cache_sheaves(s);
 		return 0;
+	}
 
 error:
 	__kmem_cache_release(s);
@@ -5403,6 +5667,12 @@ static ssize_t cpu_partial_store(struct kmem_cache *s, const char *buf,
 }
 SLAB_ATTR(cpu_partial);
 
+static ssize_t sheaf_capacity_show(struct kmem_cache *s, char *buf)
+{
+	return sysfs_emit(buf, "%u\n", s->sheaf_capacity);
+}
+SLAB_ATTR_RO(sheaf_capacity);
+
 static ssize_t ctor_show(struct kmem_cache *s, char *buf)
 {
 	if (!s->ctor)
@@ -5712,6 +5982,10 @@ STAT_ATTR(CPU_PARTIAL_ALLOC, cpu_partial_alloc);
 STAT_ATTR(CPU_PARTIAL_FREE, cpu_partial_free);
 STAT_ATTR(CPU_PARTIAL_NODE, cpu_partial_node);
 STAT_ATTR(CPU_PARTIAL_DRAIN, cpu_partial_drain);
+STAT_ATTR(SHEAF_ALLOC, sheaf_alloc);
+STAT_ATTR(SHEAF_FREE, sheaf_free);
+STAT_ATTR(SHEAF_REFILL, sheaf_refill);
+STAT_ATTR(SHEAF_FLUSH, sheaf_flush);
 #endif	/* CONFIG_SLUB_STATS */
 
 #ifdef CONFIG_KFENCE
@@ -5744,6 +6018,7 @@ static struct attribute *slab_attrs[] = {
 	&order_attr.attr,
 	&min_partial_attr.attr,
 	&cpu_partial_attr.attr,
+	&sheaf_capacity_attr.attr,
 	&objects_attr.attr,
 	&objects_partial_attr.attr,
 	&partial_attr.attr,
@@ -5799,6 +6074,10 @@ static struct attribute *slab_attrs[] = {
 	&cpu_partial_free_attr.attr,
 	&cpu_partial_node_attr.attr,
 	&cpu_partial_drain_attr.attr,
+	&sheaf_alloc_attr.attr,
+	&sheaf_free_attr.attr,
+	&sheaf_refill_attr.attr,
+	&sheaf_flush_attr.attr,
 #endif
 #ifdef CONFIG_FAILSLAB
 	&failslab_attr.attr,
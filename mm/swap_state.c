@@ -59,6 +59,24 @@ static bool enable_vma_readahead __read_mostly = true;
 #define GET_SWAP_RA_VAL(vma)					\
 	(atomic_long_read(&(vma)->swap_readahead_info) ? : 4)
 
+/*
+ * Swap-in stride of a VMA, in pages, and how many times in a row it
+ * repeated. Once the confidence reaches SWAP_RA_STRIDE_CONF_MIN, the
+ * next entries along the stride are read ahead instead of the window
+ * around the faulting address.
+ */
+#define SWAP_RA_STRIDE_CONF_BITS	2
+#define SWAP_RA_STRIDE_CONF_MASK	((1L << SWAP_RA_STRIDE_CONF_BITS) - 1)
+#define SWAP_RA_STRIDE_CONF_MAX		SWAP_RA_STRIDE_CONF_MASK
+#define SWAP_RA_STRIDE_CONF_MIN		2
+
+#define SWAP_RA_STRIDE(v)	((long)(v) >> SWAP_RA_STRIDE_CONF_BITS)
+#define SWAP_RA_STRIDE_CONF(v)	((v) & SWAP_RA_STRIDE_CONF_MASK)
+
+#define SWAP_RA_STRIDE_VAL(stride, conf)				\
+	(((stride) * (1L << SWAP_RA_STRIDE_CONF_BITS)) |		\
+	 ((conf) & SWAP_RA_STRIDE_CONF_MASK))
+
 static atomic_t swapin_readahead_hits = ATOMIC_INIT(4);
 
 void show_swap_cache_info(void)
@@ -319,6 +337,41 @@ static inline bool swap_use_vma_readahead(void)
 	return READ_ONCE(enable_vma_readahead) && !atomic_read(&nr_rotate_swap);
 }
 
+/*
+ * Feed the distance between the previous and the current swap-in of
+ * the VMA to its stride detector. A single outlier only lowers the
+ * confidence, so that an established stride survives an unrelated
+ * fault in between.
+ */
+static long swap_ra_update_stride(struct vm_area_struct *vma,
+				  unsigned long prev_pfn, unsigned long pfn)
+{
+	long val = atomic_long_read(&vma->swap_ra_stride);
+	long stride = SWAP_RA_STRIDE(val);
+	long conf = SWAP_RA_STRIDE_CONF(val);
+	long delta = (long)(pfn - prev_pfn);
+
+	/* A refault of the same page says nothing about the pattern */
+	if (!delta)
+		return val;
+
+	if (conf >= SWAP_RA_STRIDE_CONF_MIN)
+		count_vm_event(delta == stride ? SWAP_RA_STRIDE_HIT :
+						 SWAP_RA_STRIDE_MISS);
+
+	if (delta == stride)
+		conf = min_t(long, conf + 1, SWAP_RA_STRIDE_CONF_MAX);
+	else if (conf)
+		conf--;
+	else
+		stride = delta;
+
+	val = SWAP_RA_STRIDE_VAL(stride, conf);
+	atomic_long_set(&vma->swap_ra_stride, val);
+
+	return val;
+}
+
 /*
  * Lookup a swap entry in the swap cache. A found folio will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
@@ -356,6 +409,8 @@ struct folio *swap_cache_get_folio(swp_entry_t entry,
 			ra_val = GET_SWAP_RA_VAL(vma);
 			win = SWAP_RA_WIN(ra_val);
 			hits = SWAP_RA_HITS(ra_val);
+			swap_ra_update_stride(vma, PFN_DOWN(SWAP_RA_ADDR(ra_val)),
+					      PFN_DOWN(addr));
 			if (readahead)
 				hits = min_t(int, hits + 1, SWAP_RA_HITS_MAX);
 			atomic_long_set(&vma->swap_readahead_info,
@@ -490,7 +545,7 @@ struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	if (add_to_swap_cache(folio, entry, gfp_mask & GFP_RECLAIM_MASK, &shadow))
 		goto fail_unlock;
 
-	mem_cgroup_swapin_uncharge_swap(entry);
+	mem_cgroup_swapin_uncharge_swap(entry, 1);
 
 	if (shadow)
 		workingset_refault(folio, shadow);
@@ -713,6 +768,7 @@ static void swap_ra_info(struct vm_fault *vmf,
 			struct vma_swap_readahead *ra_info)
 {
 	struct vm_area_struct *vma = vmf->vma;
+	long stride_val, stride;
 	unsigned long ra_val;
 	unsigned long faddr, pfn, fpfn;
 	unsigned long start, end;
@@ -737,12 +793,29 @@ static void swap_ra_info(struct vm_fault *vmf,
 	pfn = PFN_DOWN(SWAP_RA_ADDR(ra_val));
 	prev_win = SWAP_RA_WIN(ra_val);
 	hits = SWAP_RA_HITS(ra_val);
-	ra_info->win = win = __swapin_nr_pages(pfn, fpfn, hits,
-					       max_win, prev_win);
+	stride_val = swap_ra_update_stride(vma, pfn, fpfn);
+	win = __swapin_nr_pages(pfn, fpfn, hits, max_win, prev_win);
+
+	/*
+	 * Adjacent faults are served by the window around the faulting
+	 * address already. For a confirmed sparse stride, start with a
+	 * window that grows with the confidence and let readahead hits
+	 * scale it from there.
+	 */
+	stride = SWAP_RA_STRIDE(stride_val);
+	if (SWAP_RA_STRIDE_CONF(stride_val) >= SWAP_RA_STRIDE_CONF_MIN &&
+	    (stride > 1 || stride < -1)) {
+		win = max_t(unsigned int, win,
+			    1 << SWAP_RA_STRIDE_CONF(stride_val));
+		win = min(win, max_win);
+		ra_info->stride = stride;
+	}
+
+	ra_info->win = win;
 	atomic_long_set(&vma->swap_readahead_info,
 			SWAP_RA_VAL(faddr, win, 0));
 
-	if (win == 1) {
+	if (win == 1 || ra_info->stride) {
 		pte_unmap(orig_pte);
 		return;
 	}
@@ -771,6 +844,88 @@ static void swap_ra_info(struct vm_fault *vmf,
 	pte_unmap(orig_pte);
 }
 
+/*
+ * Read the PTE mapping @addr, which may lie outside of the page table of
+ * the faulting address. Returns an empty PTE if there is no page table
+ * or it is mapped by a huge entry.
+ */
+static pte_t swap_ra_get_pte(struct vm_area_struct *vma, unsigned long addr)
+{
+	pgd_t *pgd;
+	p4d_t *p4d;
+	pud_t *pud;
+	pmd_t *pmd, pmdval;
+	pte_t *ptep, pte = __pte(0);
+
+	pgd = pgd_offset(vma->vm_mm, addr);
+	if (pgd_none(*pgd) || unlikely(pgd_bad(*pgd)))
+		return pte;
+
+	p4d = p4d_offset(pgd, addr);
+	if (p4d_none(*p4d) || unlikely(p4d_bad(*p4d)))
+		return pte;
+
+	pud = pud_offset(p4d, addr);
+	if (pud_none(*pud) || unlikely(pud_bad(*pud)))
+		return pte;
+
+	pmd = pmd_offset(pud, addr);
+	pmdval = pmd_read_atomic(pmd);
+	/* See the comment in pmd_none_or_trans_huge_or_clear_bad() */
+	barrier();
+	if (pmd_none(pmdval) || pmd_trans_huge(pmdval) ||
+	    unlikely(pmd_bad(pmdval)))
+		return pte;
+
+	ptep = pte_offset_map(pmd, addr);
+	pte = *ptep;
+	pte_unmap(ptep);
+
+	return pte;
+}
+
+/*
+ * Read ahead the entries which follow the faulting address along the
+ * stride predicted by swap_ra_info(), as long as they stay in the VMA.
+ */
+static void swap_ra_stride(struct vm_fault *vmf,
+			   struct vma_swap_readahead *ra_info,
+			   gfp_t gfp_mask, struct swap_iocb **splug)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long addr = vmf->address & PAGE_MASK;
+	long step = ra_info->stride * (long)PAGE_SIZE;
+	struct page *page;
+	pte_t pentry;
+	swp_entry_t entry;
+	unsigned int i;
+	bool page_allocated;
+
+	for (i = 1; i < ra_info->win; i++) {
+		addr += step;
+		if (addr < vma->vm_start || addr >= vma->vm_end)
+			break;
+
+		pentry = swap_ra_get_pte(vma, addr);
+		if (!is_swap_pte(pentry))
+			continue;
+		entry = pte_to_swp_entry(pentry);
+		if (unlikely(non_swap_entry(entry)))
+			continue;
+		page = __read_swap_cache_async(entry, gfp_mask, vma,
+					       addr, &page_allocated);
+		if (!page)
+			continue;
+		if (page_allocated) {
+			swap_readpage(page, false, splug);
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+			count_vm_event(SWAP_RA_STRIDE);
+		}
+		put_page(page);
+	}
+}
+
 /**
  * swap_vma_readahead - swap in pages in hope we need them soon
  * @fentry: swap entry of this memory
@@ -780,7 +935,9 @@ static void swap_ra_info(struct vm_fault *vmf,
  * Returns the struct page for entry and addr, after queueing swapin.
  *
  * Primitive swap readahead code. We simply read in a few pages whose
- * virtual addresses are around the fault address in the same vma.
+ * virtual addresses are around the fault address in the same vma, or
+ * which follow it along a stride that the recent swap-ins of the vma
+ * have repeated.
  *
  * Caller must hold read mmap_lock if vmf->vma is not NULL.
  *
@@ -805,6 +962,11 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 		goto skip;
 
 	blk_start_plug(&plug);
+	if (ra_info.stride) {
+		swap_ra_stride(vmf, &ra_info, gfp_mask, &splug);
+		goto unplug;
+	}
+
 	for (i = 0, pte = ra_info.ptes; i < ra_info.nr_pte;
 	     i++, pte++) {
 		pentry = *pte;
@@ -826,6 +988,7 @@ static struct page *swap_vma_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 		}
 		put_page(page);
 	}
+unplug:
 	blk_finish_plug(&plug);
 	swap_read_unplug(splug);
 	lru_add_drain();
@@ -773,6 +773,44 @@ static LIST_HEAD(free_vmap_area_list);
  */
 static struct rb_root free_vmap_area_root = RB_ROOT;
 
+/*
+ * Every CPU owns a vmap zone, which serves small and medium sized
+ * requests of the whole vmalloc range out of chunks carved from the
+ * global free tree. A zone has its own free and lazily-freed trees, each
+ * under its own lock, so that parallel vmalloc()/vfree() callers do not
+ * all serialize on free_vmap_area_lock and purge_vmap_area_lock. Free
+ * areas of a zone never coalesce across a chunk boundary, therefore a
+ * chunk can be handed back to the global tree once it is entirely free.
+ *
+ * Anything that does not fit, or a zone which can not get a new chunk,
+ * falls back to the global allocator.
+ */
+#define VMAP_ZONE_CHUNK_SHIFT	25	/* 32MB */
+#define VMAP_ZONE_CHUNK_SIZE	(1UL << VMAP_ZONE_CHUNK_SHIFT)
+#define VMAP_ZONE_MAX_ALLOC	(VMAP_ZONE_CHUNK_SIZE >> 3)
+
+struct vmap_zone {
+	/* Free space of the chunks owned by this zone. */
+	spinlock_t lock;
+	struct rb_root free_root;
+	struct list_head free_list;
+	unsigned int nr_chunks;
+
+	/* Lazily-freed areas, waiting for a TLB flush. */
+	spinlock_t purge_lock;
+	struct rb_root purge_root;
+	struct list_head purge_list;
+
+	/* Areas under the TLB flush in progress, see vmap_purge_lock. */
+	struct list_head flush_list;
+};
+
+static DEFINE_PER_CPU_ALIGNED(struct vmap_zone, vmap_zone);
+static bool vmap_zones_enabled __read_mostly;
+
+/* Chunk index to owning zone. */
+static DEFINE_XARRAY(vmap_zone_chunks);
+
 /*
  * Preload a CPU with one object for "no edge" split case. The
  * aim is to get rid of allocations from the atomic context, thus
@@ -1124,9 +1162,20 @@ insert_vmap_area_augment(struct vmap_area *va,
  * buggy behaviour, a system can be alive and keep
  * ongoing.
  */
+static __always_inline bool
+va_can_merge_at(unsigned long addr, unsigned long boundary)
+{
+	return !boundary || !IS_ALIGNED(addr, boundary);
+}
+
+/*
+ * Please note, that a non-zero "boundary" prevents two areas from
+ * being coalesced when they meet at an address aligned to it.
+ */
 static __always_inline struct vmap_area *
 __merge_or_add_vmap_area(struct vmap_area *va,
-	struct rb_root *root, struct list_head *head, bool augment)
+	struct rb_root *root, struct list_head *head,
+	unsigned long boundary, bool augment)
 {
 	struct vmap_area *sibling;
 	struct list_head *next;
@@ -1158,7 +1207,8 @@ __merge_or_add_vmap_area(struct vmap_area *va,
 	 */
 	if (next != head) {
 		sibling = list_entry(next, struct vmap_area, list);
-		if (sibling->va_start == va->va_end) {
+		if (sibling->va_start == va->va_end &&
+				va_can_merge_at(va->va_end, boundary)) {
 			sibling->va_start = va->va_start;
 
 			/* Free vmap_area object. */
@@ -1179,7 +1229,8 @@ __merge_or_add_vmap_area(struct vmap_area *va,
 	 */
 	if (next->prev != head) {
 		sibling = list_entry(next->prev, struct vmap_area, list);
-		if (sibling->va_end == va->va_start) {
+		if (sibling->va_end == va->va_start &&
+				va_can_merge_at(va->va_start, boundary)) {
 			/*
 			 * If both neighbors are coalesced, it is important
 			 * to unlink the "next" node first, followed by merging
@@ -1212,14 +1263,14 @@ static __always_inline struct vmap_area *
 merge_or_add_vmap_area(struct vmap_area *va,
 	struct rb_root *root, struct list_head *head)
 {
-	return __merge_or_add_vmap_area(va, root, head, false);
+	return __merge_or_add_vmap_area(va, root, head, 0, false);
 }
 
 static __always_inline struct vmap_area *
 merge_or_add_vmap_area_augment(struct vmap_area *va,
 	struct rb_root *root, struct list_head *head)
 {
-	va = __merge_or_add_vmap_area(va, root, head, true);
+	va = __merge_or_add_vmap_area(va, root, head, 0, true);
 	if (va)
 		augment_tree_propagate_from(va);
 
@@ -1540,11 +1591,73 @@ __alloc_vmap_area(struct rb_root *root, struct list_head *head,
 	return nva_start_addr;
 }
 
+/*
+ * Returns a zone the address belongs to, or NULL if it is
+ * managed by the global allocator.
+ */
+static __always_inline struct vmap_zone *
+addr_to_vmap_zone(unsigned long addr)
+{
+	if (!vmap_zones_enabled)
+		return NULL;
+
+	return xa_load(&vmap_zone_chunks, addr >> VMAP_ZONE_CHUNK_SHIFT);
+}
+
+static __always_inline struct vmap_area *
+vmap_zone_merge_or_add(struct vmap_zone *vz, struct vmap_area *va)
+{
+	va = __merge_or_add_vmap_area(va, &vz->free_root, &vz->free_list,
+		VMAP_ZONE_CHUNK_SIZE, true);
+	if (va)
+		augment_tree_propagate_from(va);
+
+	return va;
+}
+
+/*
+ * Detach a chunk which is entirely free. The caller holds vz->lock
+ * and hands the chunk over to vmap_zone_release_chunks() afterwards.
+ */
+static __always_inline bool
+vmap_zone_detach_chunk(struct vmap_zone *vz, struct vmap_area *va,
+	struct list_head *chunks, unsigned int keep)
+{
+	if (va_size(va) != VMAP_ZONE_CHUNK_SIZE || vz->nr_chunks <= keep)
+		return false;
+
+	unlink_va_augment(va, &vz->free_root);
+	list_add(&va->list, chunks);
+	vz->nr_chunks--;
+
+	return true;
+}
+
+/*
+ * Give detached chunks back to the global free tree.
+ */
+static void vmap_zone_release_chunks(struct list_head *chunks)
+{
+	struct vmap_area *va, *n_va;
+
+	list_for_each_entry_safe(va, n_va, chunks, list) {
+		list_del_init(&va->list);
+		xa_erase(&vmap_zone_chunks, va->va_start >> VMAP_ZONE_CHUNK_SHIFT);
+
+		spin_lock(&free_vmap_area_lock);
+		merge_or_add_vmap_area_augment(va, &free_vmap_area_root,
+			&free_vmap_area_list);
+		spin_unlock(&free_vmap_area_lock);
+	}
+}
+
 /*
  * Free a region of KVA allocated by alloc_vmap_area
  */
 static void free_vmap_area(struct vmap_area *va)
 {
+	struct vmap_zone *vz;
+
 	/*
 	 * Remove from the busy tree/list.
 	 */
@@ -1555,6 +1668,14 @@ static void free_vmap_area(struct vmap_area *va)
 	/*
 	 * Insert/Merge it back to the free tree/list.
 	 */
+	vz = addr_to_vmap_zone(va->va_start);
+	if (vz) {
+		spin_lock(&vz->lock);
+		vmap_zone_merge_or_add(vz, va);
+		spin_unlock(&vz->lock);
+		return;
+	}
+
 	spin_lock(&free_vmap_area_lock);
 	merge_or_add_vmap_area_augment(va, &free_vmap_area_root, &free_vmap_area_list);
 	spin_unlock(&free_vmap_area_lock);
@@ -1583,6 +1704,128 @@ preload_this_cpu_lock(spinlock_t *lock, gfp_t gfp_mask, int node)
 		kmem_cache_free(vmap_area_cachep, va);
 }
 
+/*
+ * Only requests which can be placed anywhere in the vmalloc space
+ * and which are small compared to a chunk are served by zones.
+ */
+static __always_inline struct vmap_zone *
+vmap_zone_for_request(unsigned long size, unsigned long align,
+	unsigned long vstart, unsigned long vend)
+{
+	if (!vmap_zones_enabled)
+		return NULL;
+
+	if (vstart != VMALLOC_START || vend != VMALLOC_END)
+		return NULL;
+
+	if (size > VMAP_ZONE_MAX_ALLOC || align > VMAP_ZONE_MAX_ALLOC)
+		return NULL;
+
+	return raw_cpu_ptr(&vmap_zone);
+}
+
+/*
+ * Carve out a new chunk from the global free space and pass it to
+ * the zone. Returns false if the global allocator can not provide it.
+ */
+static bool vmap_zone_grow(struct vmap_zone *vz, int node, gfp_t gfp_mask)
+{
+	struct vmap_area *va;
+	unsigned long addr;
+	int ret;
+
+	va = kmem_cache_alloc_node(vmap_area_cachep, gfp_mask, node);
+	if (unlikely(!va))
+		return false;
+
+	preload_this_cpu_lock(&free_vmap_area_lock, gfp_mask, node);
+	addr = __alloc_vmap_area(&free_vmap_area_root, &free_vmap_area_list,
+		VMAP_ZONE_CHUNK_SIZE, VMAP_ZONE_CHUNK_SIZE,
+		VMALLOC_START, VMALLOC_END);
+	spin_unlock(&free_vmap_area_lock);
+
+	if (addr == VMALLOC_END) {
+		kmem_cache_free(vmap_area_cachep, va);
+		return false;
+	}
+
+	va->va_start = addr;
+	va->va_end = addr + VMAP_ZONE_CHUNK_SIZE;
+
+	/*
+	 * The owner has to be known before anything of the chunk
+	 * can be allocated, because the free path relies on it.
+	 */
+	ret = xa_err(xa_store(&vmap_zone_chunks,
+		addr >> VMAP_ZONE_CHUNK_SHIFT, vz, gfp_mask));
+	if (ret) {
+		spin_lock(&free_vmap_area_lock);
+		merge_or_add_vmap_area_augment(va, &free_vmap_area_root,
+			&free_vmap_area_list);
+		spin_unlock(&free_vmap_area_lock);
+		return false;
+	}
+
+	spin_lock(&vz->lock);
+	vmap_zone_merge_or_add(vz, va);
+	vz->nr_chunks++;
+	spin_unlock(&vz->lock);
+
+	return true;
+}
+
+/*
+ * Returns a start address of the newly allocated area, if success.
+ * Otherwise VMALLOC_END is returned that indicates failure.
+ */
+static unsigned long
+vmap_zone_alloc(struct vmap_zone *vz, unsigned long size,
+	unsigned long align, int node, gfp_t gfp_mask)
+{
+	unsigned long addr;
+	bool grown = false;
+
+	do {
+		preload_this_cpu_lock(&vz->lock, gfp_mask, node);
+		addr = __alloc_vmap_area(&vz->free_root, &vz->free_list,
+			size, align, VMALLOC_START, VMALLOC_END);
+		spin_unlock(&vz->lock);
+
+		if (addr != VMALLOC_END || grown)
+			break;
+
+		grown = true;
+	} while (vmap_zone_grow(vz, node, gfp_mask));
+
+	return addr;
+}
+
+/*
+ * Give all entirely free chunks of all zones back to the global
+ * allocator. It is a last resort before an allocation is failed.
+ */
+static void vmap_zones_shrink(void)
+{
+	struct vmap_area *va, *n_va;
+	struct vmap_zone *vz;
+	LIST_HEAD(chunks);
+	int cpu;
+
+	if (!vmap_zones_enabled)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		vz = per_cpu_ptr(&vmap_zone, cpu);
+
+		spin_lock(&vz->lock);
+		list_for_each_entry_safe(va, n_va, &vz->free_list, list)
+			vmap_zone_detach_chunk(vz, va, &chunks, 0);
+		spin_unlock(&vz->lock);
+	}
+
+	vmap_zone_release_chunks(&chunks);
+}
+
 /*
  * Allocate a region of KVA of the specified size and alignment, within the
  * vstart and vend.
@@ -1592,6 +1835,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				unsigned long vstart, unsigned long vend,
 				int node, gfp_t gfp_mask)
 {
+	struct vmap_zone *vz;
 	struct vmap_area *va;
 	unsigned long freed;
 	unsigned long addr;
@@ -1618,11 +1862,19 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 	 */
 	kmemleak_scan_area(&va->rb_node, SIZE_MAX, gfp_mask);
 
+	vz = vmap_zone_for_request(size, align, vstart, vend);
+
 retry:
-	preload_this_cpu_lock(&free_vmap_area_lock, gfp_mask, node);
-	addr = __alloc_vmap_area(&free_vmap_area_root, &free_vmap_area_list,
-		size, align, vstart, vend);
-	spin_unlock(&free_vmap_area_lock);
+	addr = vend;
+	if (vz)
+		addr = vmap_zone_alloc(vz, size, align, node, gfp_mask);
+
+	if (addr == vend) {
+		preload_this_cpu_lock(&free_vmap_area_lock, gfp_mask, node);
+		addr = __alloc_vmap_area(&free_vmap_area_root, &free_vmap_area_list,
+			size, align, vstart, vend);
+		spin_unlock(&free_vmap_area_lock);
+	}
 
 	/*
 	 * If an allocation fails, the "vend" address is
@@ -1654,6 +1906,7 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 overflow:
 	if (!purged) {
 		purge_vmap_area_lazy();
+		vmap_zones_shrink();
 		purged = 1;
 		goto retry;
 	}
@@ -1724,13 +1977,90 @@ static DEFINE_MUTEX(vmap_purge_lock);
 static void purge_fragmented_blocks_allcpus(void);
 
 /*
- * Purges all lazily-freed vmap areas.
+ * Detach lazily-freed areas of all zones, extending the [start:end)
+ * range to be flushed. Returns true if there is anything to purge.
+ */
+static bool vmap_zones_detach_lazy(unsigned long *start, unsigned long *end)
+{
+	struct vmap_zone *vz;
+	bool pending = false;
+	int cpu;
+
+	if (!vmap_zones_enabled)
+		return false;
+
+	for_each_possible_cpu(cpu) {
+		vz = per_cpu_ptr(&vmap_zone, cpu);
+
+		spin_lock(&vz->purge_lock);
+		vz->purge_root = RB_ROOT;
+		list_replace_init(&vz->purge_list, &vz->flush_list);
+		spin_unlock(&vz->purge_lock);
+
+		if (list_empty(&vz->flush_list))
+			continue;
+
+		*start = min(*start, list_first_entry(&vz->flush_list,
+			struct vmap_area, list)->va_start);
+		*end = max(*end, list_last_entry(&vz->flush_list,
+			struct vmap_area, list)->va_end);
+		pending = true;
+	}
+
+	return pending;
+}
+
+/*
+ * Return flushed areas of a zone to its free tree. A chunk which
+ * becomes entirely free goes back to the global allocator, as long
+ * as the zone keeps another one.
+ */
+static void vmap_zone_reclaim_lazy(struct vmap_zone *vz,
+	unsigned long resched_threshold)
+{
+	struct vmap_area *va, *n_va;
+	LIST_HEAD(chunks);
+
+	if (list_empty(&vz->flush_list))
+		return;
+
+	spin_lock(&vz->lock);
+	list_for_each_entry_safe(va, n_va, &vz->flush_list, list) {
+		unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
+		unsigned long orig_start = va->va_start;
+		unsigned long orig_end = va->va_end;
+
+		va = vmap_zone_merge_or_add(vz, va);
+		if (!va)
+			continue;
+
+		kasan_release_vmalloc(orig_start, orig_end,
+				      va->va_start, va->va_end);
+
+		atomic_long_sub(nr, &vmap_lazy_nr);
+		vmap_zone_detach_chunk(vz, va, &chunks, 1);
+
+		if (atomic_long_read(&vmap_lazy_nr) < resched_threshold)
+			cond_resched_lock(&vz->lock);
+	}
+	spin_unlock(&vz->lock);
+
+	/* All entries have been moved, the list head is stale. */
+	INIT_LIST_HEAD(&vz->flush_list);
+	vmap_zone_release_chunks(&chunks);
+}
+
+/*
+ * Purges all lazily-freed vmap areas. The global and the per-zone
+ * lazy lists are flushed with one TLB flush.
  */
 static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 {
 	unsigned long resched_threshold;
 	struct list_head local_purge_list;
 	struct vmap_area *va, *n_va;
+	bool zones_pending;
+	int cpu;
 
 	lockdep_assert_held(&vmap_purge_lock);
 
@@ -1739,20 +2069,33 @@ static bool __purge_vmap_area_lazy(unsigned long start, unsigned long end)
 	list_replace_init(&purge_vmap_area_list, &local_purge_list);
 	spin_unlock(&purge_vmap_area_lock);
 
-	if (unlikely(list_empty(&local_purge_list)))
+	zones_pending = vmap_zones_detach_lazy(&start, &end);
+
+	if (unlikely(list_empty(&local_purge_list) && !zones_pending))
 		return false;
 
-	start = min(start,
-		list_first_entry(&local_purge_list,
-			struct vmap_area, list)->va_start);
+	if (!list_empty(&local_purge_list)) {
+		start = min(start,
+			list_first_entry(&local_purge_list,
+				struct vmap_area, list)->va_start);
 
-	end = max(end,
-		list_last_entry(&local_purge_list,
-			struct vmap_area, list)->va_end);
+		end = max(end,
+			list_last_entry(&local_purge_list,
+				struct vmap_area, list)->va_end);
+	}
 
 	flush_tlb_kernel_range(start, end);
 	resched_threshold = lazy_max_pages() << 1;
 
+	if (zones_pending) {
+		for_each_possible_cpu(cpu)
+			vmap_zone_reclaim_lazy(per_cpu_ptr(&vmap_zone, cpu),
+				resched_threshold);
+	}
+
+	if (list_empty(&local_purge_list))
+		return true;
+
 	spin_lock(&free_vmap_area_lock);
 	list_for_each_entry_safe(va, n_va, &local_purge_list, list) {
 		unsigned long nr = (va->va_end - va->va_start) >> PAGE_SHIFT;
@@ -1815,6 +2158,7 @@ static void drain_vmap_area_work(struct work_struct *work)
  */
 static void free_vmap_area_noflush(struct vmap_area *va)
 {
+	struct vmap_zone *vz;
 	unsigned long nr_lazy;
 
 	spin_lock(&vmap_area_lock);
@@ -1827,10 +2171,18 @@ static void free_vmap_area_noflush(struct vmap_area *va)
 	/*
 	 * Merge or place it to the purge tree/list.
 	 */
-	spin_lock(&purge_vmap_area_lock);
-	merge_or_add_vmap_area(va,
-		&purge_vmap_area_root, &purge_vmap_area_list);
-	spin_unlock(&purge_vmap_area_lock);
+	vz = addr_to_vmap_zone(va->va_start);
+	if (vz) {
+		spin_lock(&vz->purge_lock);
+		__merge_or_add_vmap_area(va, &vz->purge_root, &vz->purge_list,
+			VMAP_ZONE_CHUNK_SIZE, false);
+		spin_unlock(&vz->purge_lock);
+	} else {
+		spin_lock(&purge_vmap_area_lock);
+		merge_or_add_vmap_area(va,
+			&purge_vmap_area_root, &purge_vmap_area_list);
+		spin_unlock(&purge_vmap_area_lock);
+	}
 
 	/* After this point, we may free va at any time */
 	if (unlikely(nr_lazy > lazy_max_pages()))
@@ -2420,6 +2772,7 @@ void __init vmalloc_init(void)
 	for_each_possible_cpu(i) {
 		struct vmap_block_queue *vbq;
 		struct vfree_deferred *p;
+		struct vmap_zone *vz;
 
 		vbq = &per_cpu(vmap_block_queue, i);
 		spin_lock_init(&vbq->lock);
@@ -2427,8 +2780,23 @@ void __init vmalloc_init(void)
 		p = &per_cpu(vfree_deferred, i);
 		init_llist_head(&p->list);
 		INIT_WORK(&p->wq, free_work);
+
+		vz = &per_cpu(vmap_zone, i);
+		spin_lock_init(&vz->lock);
+		vz->free_root = RB_ROOT;
+		INIT_LIST_HEAD(&vz->free_list);
+		spin_lock_init(&vz->purge_lock);
+		vz->purge_root = RB_ROOT;
+		INIT_LIST_HEAD(&vz->purge_list);
+		INIT_LIST_HEAD(&vz->flush_list);
 	}
 
+	/*
+	 * The vmalloc space of 32-bit systems is too small to be
+	 * split into per-CPU chunks.
+	 */
+	vmap_zones_enabled = IS_ENABLED(CONFIG_64BIT);
+
 	/* Import existing vmlist entries. */
 	for (tmp = vmlist; tmp; tmp = tmp->next) {
 		va = kmem_cache_zalloc(vmap_area_cachep, GFP_NOWAIT);
@@ -3986,6 +4354,7 @@ struct vm_struct **pcpu_get_vm_areas(const unsigned long *offsets,
 	spin_unlock(&free_vmap_area_lock);
 	if (!purged) {
 		purge_vmap_area_lazy();
+		vmap_zones_shrink();
 		purged = true;
 
 		/* Before "retry", check if we recover. */
@@ -4136,17 +4505,34 @@ static void show_numa_info(struct seq_file *m, struct vm_struct *v)
 	}
 }
 
-static void show_purge_info(struct seq_file *m)
+static void show_purge_list(struct seq_file *m, spinlock_t *lock,
+	struct list_head *head)
 {
 	struct vmap_area *va;
 
-	spin_lock(&purge_vmap_area_lock);
-	list_for_each_entry(va, &purge_vmap_area_list, list) {
+	spin_lock(lock);
+	list_for_each_entry(va, head, list) {
 		seq_printf(m, "0x%pK-0x%pK %7ld unpurged vm_area\n",
 			(void *)va->va_start, (void *)va->va_end,
 			va->va_end - va->va_start);
 	}
-	spin_unlock(&purge_vmap_area_lock);
+	spin_unlock(lock);
+}
+
+static void show_purge_info(struct seq_file *m)
+{
+	struct vmap_zone *vz;
+	int cpu;
+
+	show_purge_list(m, &purge_vmap_area_lock, &purge_vmap_area_list);
+
+	if (!vmap_zones_enabled)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		vz = per_cpu_ptr(&vmap_zone, cpu);
+		show_purge_list(m, &vz->purge_lock, &vz->purge_list);
+	}
 }
 
 static int s_show(struct seq_file *m, void *p)
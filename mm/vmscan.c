@@ -1609,10 +1609,8 @@ static unsigned int demote_folio_list(struct list_head *demote_folios,
 		      (unsigned long)&mtc, MIGRATE_ASYNC, MR_DEMOTION,
 		      &nr_succeeded);
 
-	if (current_is_kswapd())
-		__count_vm_events(PGDEMOTE_KSWAPD, nr_succeeded);
-	else
-		__count_vm_events(PGDEMOTE_DIRECT, nr_succeeded);
+	mod_node_page_state(pgdat, current_is_kswapd() ?
+			    PGDEMOTE_KSWAPD : PGDEMOTE_DIRECT, nr_succeeded);
 
 	return nr_succeeded;
 }
@@ -1633,6 +1631,28 @@ static bool may_enter_fs(struct folio *folio, gfp_t gfp_mask)
 	return !data_race(folio_swap_flags(folio) & SWP_FS_OPS);
 }
 
+/*
+ * A large folio mapped by PTEs only may have lost some subpages to a
+ * partial unmap. If every subpage is still mapped, there is nothing to
+ * gain from splitting it, and it can be swapped out as a whole.
+ */
+static bool folio_partially_mapped(struct folio *folio)
+{
+	long i, nr = folio_nr_pages(folio);
+
+	if (folio_entire_mapcount(folio))
+		return false;
+
+	if (!IS_ENABLED(CONFIG_THP_SWAP))
+		return true;
+
+	for (i = 0; i < nr; i++) {
+		if (!page_mapcount(folio_page(folio, i)))
+			return true;
+	}
+	return false;
+}
+
 /*
  * shrink_folio_list() returns the number of reclaimed pages
  */
@@ -1832,11 +1852,11 @@ static unsigned int shrink_folio_list(struct list_head *folio_list,
 					if (!can_split_folio(folio, NULL))
 						goto activate_locked;
 					/*
-					 * Split folios without a PMD map right
+					 * Split partially mapped folios right
 					 * away. Chances are some or all of the
 					 * tail pages can be freed without IO.
 					 */
-					if (!folio_entire_mapcount(folio) &&
+					if (folio_partially_mapped(folio) &&
 					    split_folio_to_list(folio,
 								folio_list))
 						goto activate_locked;
@@ -2816,7 +2836,7 @@ static void prepare_scan_count(pg_data_t *pgdat, struct scan_control *sc)
 	 * Flush the memory cgroup stats, so that we read accurate per-memcg
 	 * lruvec stats for heuristics.
 	 */
-	mem_cgroup_flush_stats();
+	mem_cgroup_flush_stats(sc->target_mem_cgroup);
 
 	/*
 	 * Determine the scan balance between anon and file LRUs.
@@ -4383,9 +4403,94 @@ static void inc_max_seq(struct lruvec *lruvec, bool can_swap, bool force_scan)
 	spin_unlock_irq(&lruvec->lru_lock);
 }
 
+/*
+ * Parallel aging: kswapd can be helped by up to lru_gen_aging_walkers workers
+ * when it walks the mm_list of an lruvec. Each worker uses its own walk and
+ * pulls mm_structs from the same lruvec->mm_state iterator as kswapd, so the
+ * mm_list is partitioned on the fly. kswapd waits for its helpers before
+ * incrementing max_seq, which keeps them from aborting their walks midway.
+ */
+#define MAX_LRU_GEN_AGING_WALKERS	16
+
+static unsigned int lru_gen_aging_walkers __read_mostly;
+static struct workqueue_struct *lru_gen_walk_wq;
+
+struct lru_gen_walk_work {
+	struct work_struct work;
+	struct lru_gen_mm_walk walk;
+	/* the helper ended the mm_list iteration */
+	bool success;
+};
+
+static void lru_gen_walk_workfn(struct work_struct *work)
+{
+	struct lru_gen_walk_work *ww = container_of(work, struct lru_gen_walk_work, work);
+	struct lru_gen_mm_walk *walk = &ww->walk;
+	struct lruvec *lruvec = walk->lruvec;
+	struct mm_struct *mm = NULL;
+	unsigned int flags;
+
+	/* don't recurse into reclaim on behalf of kswapd */
+	flags = memalloc_noreclaim_save();
+
+	do {
+		if (iterate_mm_list(lruvec, walk, &mm))
+			ww->success = true;
+		if (mm)
+			walk_mm(lruvec, mm, walk);
+	} while (mm);
+
+	memalloc_noreclaim_restore(flags);
+}
+
+static int start_aging_walkers(struct lruvec *lruvec, struct lru_gen_mm_walk *walk,
+			       struct lru_gen_walk_work **works)
+{
+	int i, nr;
+	int nid = lruvec_pgdat(lruvec)->node_id;
+
+	if (!current_is_kswapd() || !lru_gen_walk_wq)
+		return 0;
+
+	nr = min_t(int, READ_ONCE(lru_gen_aging_walkers), MAX_LRU_GEN_AGING_WALKERS);
+	nr = min_t(int, nr, cpumask_weight(cpumask_of_node(nid)));
+
+	for (i = 0; i < nr; i++) {
+		works[i] = kzalloc(sizeof(*works[i]),
+				   __GFP_HIGH | __GFP_NOMEMALLOC | __GFP_NOWARN);
+		if (!works[i])
+			break;
+
+		works[i]->walk.lruvec = walk->lruvec;
+		works[i]->walk.max_seq = walk->max_seq;
+		works[i]->walk.can_swap = walk->can_swap;
+		works[i]->walk.force_scan = walk->force_scan;
+		INIT_WORK(&works[i]->work, lru_gen_walk_workfn);
+		queue_work_node(nid, lru_gen_walk_wq, &works[i]->work);
+	}
+
+	return i;
+}
+
+static bool stop_aging_walkers(struct lru_gen_walk_work **works, int nr)
+{
+	int i;
+	bool success = false;
+
+	for (i = 0; i < nr; i++) {
+		flush_work(&works[i]->work);
+		success |= works[i]->success;
+		kfree(works[i]);
+	}
+
+	return success;
+}
+
 static bool try_to_inc_max_seq(struct lruvec *lruvec, unsigned long max_seq,
 			       struct scan_control *sc, bool can_swap, bool force_scan)
 {
+	int nr_walkers;
+	struct lru_gen_walk_work *works[MAX_LRU_GEN_AGING_WALKERS];
 	bool success;
 	struct lru_gen_mm_walk *walk;
 	struct mm_struct *mm = NULL;
@@ -4421,11 +4526,17 @@ static bool try_to_inc_max_seq(struct lruvec *lruvec, unsigned long max_seq,
 	walk->can_swap = can_swap;
 	walk->force_scan = force_scan;
 
+	nr_walkers = start_aging_walkers(lruvec, walk, works);
+
 	do {
 		success = iterate_mm_list(lruvec, walk, &mm);
 		if (mm)
 			walk_mm(lruvec, mm, walk);
 	} while (mm);
+
+	/* only one walker can end the iteration, see iterate_mm_list() */
+	if (stop_aging_walkers(works, nr_walkers))
+		success = true;
 done:
 	if (success)
 		inc_max_seq(lruvec, can_swap, force_scan);
@@ -5687,9 +5798,34 @@ static struct kobj_attribute lru_gen_enabled_attr = __ATTR(
 	enabled, 0644, show_enabled, store_enabled
 );
 
+static ssize_t show_aging_walkers(struct kobject *kobj, struct kobj_attribute *attr,
+				  char *buf)
+{
+	return sprintf(buf, "%u\n", READ_ONCE(lru_gen_aging_walkers));
+}
+
+/* number of workers helping kswapd with page table walks, 0 to disable */
+static ssize_t store_aging_walkers(struct kobject *kobj, struct kobj_attribute *attr,
+				   const char *buf, size_t len)
+{
+	unsigned int nr;
+
+	if (kstrtouint(buf, 0, &nr) || nr > MAX_LRU_GEN_AGING_WALKERS)
+		return -EINVAL;
+
+	WRITE_ONCE(lru_gen_aging_walkers, nr);
+
+	return len;
+}
+
+static struct kobj_attribute lru_gen_aging_walkers_attr = __ATTR(
+	aging_walkers, 0644, show_aging_walkers, store_aging_walkers
+);
+
 static struct attribute *lru_gen_attrs[] = {
 	&lru_gen_min_ttl_attr.attr,
 	&lru_gen_enabled_attr.attr,
+	&lru_gen_aging_walkers_attr.attr,
 	NULL
 };
 
@@ -6129,6 +6265,11 @@ static int __init init_lru_gen(void)
 	if (sysfs_create_group(mm_kobj, &lru_gen_attr_group))
 		pr_err("lru_gen: failed to create sysfs group\n");
 
+	/* parallel aging is optional, kswapd walks alone without it */
+	lru_gen_walk_wq = alloc_workqueue("lru_gen_walk", WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!lru_gen_walk_wq)
+		pr_err("lru_gen: failed to create aging workqueue\n");
+
 	debugfs_create_file("lru_gen", 0644, NULL, NULL, &lru_gen_rw_fops);
 	debugfs_create_file("lru_gen_full", 0444, NULL, NULL, &lru_gen_ro_fops);
 
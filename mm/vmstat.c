@@ -832,6 +832,10 @@ static int refresh_cpu_vm_stats(bool do_pagesets)
 #endif
 			}
 		}
+
+		if (do_pagesets &&
+		    decay_pcp_high(zone, this_cpu_ptr(zone->per_cpu_pageset)))
+			changes++;
 #ifdef CONFIG_NUMA
 
 		if (do_pagesets) {
@@ -1242,6 +1246,8 @@ const char * const vmstat_text[] = {
 	"pgpromote_success",
 	"pgpromote_candidate",
 #endif
+	"pgdemote_kswapd",
+	"pgdemote_direct",
 
 	/* enum writeback_stat_item counters */
 	"nr_dirty_threshold",
@@ -1271,8 +1277,6 @@ const char * const vmstat_text[] = {
 	"pgreuse",
 	"pgsteal_kswapd",
 	"pgsteal_direct",
-	"pgdemote_kswapd",
-	"pgdemote_direct",
 	"pgscan_kswapd",
 	"pgscan_direct",
 	"pgscan_direct_throttle",
@@ -1310,6 +1314,8 @@ const char * const vmstat_text[] = {
 	"thp_migration_success",
 	"thp_migration_fail",
 	"thp_migration_split",
+	"pgmigrate_copy_bytes",
+	"pgmigrate_copy_parallel",
 #endif
 #ifdef CONFIG_COMPACTION
 	"compact_migrate_scanned",
@@ -1349,6 +1355,8 @@ const char * const vmstat_text[] = {
 	"thp_file_fallback",
 	"thp_file_fallback_charge",
 	"thp_file_mapped",
+	"shmem_mthp_alloc",
+	"shmem_mthp_fallback",
 	"thp_split_page",
 	"thp_split_page_failed",
 	"thp_deferred_split_page",
@@ -1363,6 +1371,8 @@ const char * const vmstat_text[] = {
 	"thp_zero_page_alloc_failed",
 	"thp_swpout",
 	"thp_swpout_fallback",
+	"thp_swpin",
+	"thp_swpin_fallback",
 #endif
 #ifdef CONFIG_MEMORY_BALLOON
 	"balloon_inflate",
@@ -1381,6 +1391,9 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_SWAP
 	"swap_ra",
 	"swap_ra_hit",
+	"swap_ra_stride",
+	"swap_ra_stride_hit",
+	"swap_ra_stride_miss",
 #ifdef CONFIG_KSM
 	"ksm_swpin_copy",
 #endif
@@ -1726,11 +1739,17 @@ static void zoneinfo_show_print(struct seq_file *m, pg_data_t *pgdat,
 			   "\n    cpu: %i"
 			   "\n              count: %i"
 			   "\n              high:  %i"
-			   "\n              batch: %i",
+			   "\n              batch: %i"
+			   "\n              high_min: %i"
+			   "\n              high_max: %i"
+			   "\n              buddy_batches: %lu",
 			   i,
 			   pcp->count,
 			   pcp->high,
-			   pcp->batch);
+			   pcp->batch,
+			   pcp->high_min,
+			   pcp->high_max,
+			   pcp->buddy_batches);
 #ifdef CONFIG_SMP
 		pzstats = per_cpu_ptr(zone->per_cpu_zonestats, i);
 		seq_printf(m, "\n  vm stats threshold: %d",
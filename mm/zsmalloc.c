@@ -190,6 +190,13 @@ static struct dentry *zs_stat_root;
 static const int fullness_threshold_frac = 4;
 static size_t huge_class_size;
 
+/* Background compaction tunables, see zs_bg_compact_work() */
+static unsigned int zs_bg_compact_interval_ms;
+static unsigned int zs_bg_compact_threshold = 50;
+module_param_named(bg_compact_threshold, zs_bg_compact_threshold, uint, 0644);
+static unsigned int zs_bg_compact_budget_ms = 2;
+module_param_named(bg_compact_budget_ms, zs_bg_compact_budget_ms, uint, 0644);
+
 struct size_class {
 	struct list_head fullness_list[NR_ZS_FULLNESS];
 	/*
@@ -202,6 +209,11 @@ struct size_class {
 	int pages_per_zspage;
 
 	unsigned int index;
+	/*
+	 * Background compaction kicks in once less than this percentage
+	 * of the allocated objects is in use. 0 means zs_bg_compact_threshold.
+	 */
+	unsigned int compact_threshold;
 	struct zs_size_stat stats;
 };
 
@@ -238,6 +250,12 @@ struct zs_pool {
 
 	/* Compact classes */
 	struct shrinker shrinker;
+	/* Background compaction, see zs_bg_compact_work() */
+	struct delayed_work compact_work;
+	/* Class index the next background compaction run starts from */
+	int compact_next_class;
+	/* Link in zs_pools */
+	struct list_head list;
 
 #ifdef CONFIG_ZSMALLOC_STAT
 	struct dentry *stat_dentry;
@@ -631,6 +649,75 @@ static int zs_stats_size_show(struct seq_file *s, void *v)
 }
 DEFINE_SHOW_ATTRIBUTE(zs_stats_size);
 
+static int zs_compact_threshold_show(struct seq_file *s, void *v)
+{
+	struct zs_pool *pool = s->private;
+	struct size_class *class;
+	int i;
+
+	seq_printf(s, " %5s %5s %9s %9s\n", "class", "size", "threshold",
+		   "occupancy");
+
+	for (i = 0; i < ZS_SIZE_CLASSES; i++) {
+		unsigned long obj_allocated, obj_used;
+
+		class = pool->size_class[i];
+		if (class->index != i)
+			continue;
+
+		spin_lock(&pool->lock);
+		obj_allocated = zs_stat_get(class, OBJ_ALLOCATED);
+		obj_used = zs_stat_get(class, OBJ_USED);
+		spin_unlock(&pool->lock);
+
+		seq_printf(s, " %5u %5u %9u %9lu\n", i, class->size,
+			   READ_ONCE(class->compact_threshold) ?:
+			   READ_ONCE(zs_bg_compact_threshold),
+			   obj_allocated ? obj_used * 100 / obj_allocated : 100);
+	}
+
+	return 0;
+}
+
+static int zs_compact_threshold_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zs_compact_threshold_show, inode->i_private);
+}
+
+/* "<class> <percent>" sets the threshold of one class, 0 restores default */
+static ssize_t zs_compact_threshold_write(struct file *file,
+					  const char __user *ubuf,
+					  size_t count, loff_t *ppos)
+{
+	struct zs_pool *pool = file_inode(file)->i_private;
+	unsigned int index, percent;
+	char buf[32];
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+
+	if (sscanf(buf, "%u %u", &index, &percent) != 2)
+		return -EINVAL;
+	if (index >= ZS_SIZE_CLASSES || percent > 100)
+		return -EINVAL;
+
+	WRITE_ONCE(pool->size_class[index]->compact_threshold, percent);
+
+	return count;
+}
+
+static const struct file_operations zs_compact_threshold_fops = {
+	.owner		= THIS_MODULE,
+	.open		= zs_compact_threshold_open,
+	.read		= seq_read,
+	.write		= zs_compact_threshold_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 {
 	if (!zs_stat_root) {
@@ -642,6 +729,8 @@ static void zs_pool_stat_create(struct zs_pool *pool, const char *name)
 
 	debugfs_create_file("classes", S_IFREG | 0444, pool->stat_dentry, pool,
 			    &zs_stats_size_fops);
+	debugfs_create_file("compact_threshold", S_IFREG | 0644,
+			    pool->stat_dentry, pool, &zs_compact_threshold_fops);
 }
 
 static void zs_pool_stat_destroy(struct zs_pool *pool)
@@ -2026,8 +2115,13 @@ static unsigned long zs_can_compact(struct size_class *class)
 	return obj_wasted * class->pages_per_zspage;
 }
 
+/*
+ * Compact @class. If @deadline is non-zero, stop once jiffies reaches it,
+ * after the zspage being processed has been put back.
+ */
 static unsigned long __zs_compact(struct zs_pool *pool,
-				  struct size_class *class)
+				  struct size_class *class,
+				  unsigned long deadline)
 {
 	struct zs_compact_control cc;
 	struct zspage *src_zspage;
@@ -2080,9 +2174,12 @@ static unsigned long __zs_compact(struct zs_pool *pool,
 			pages_freed += class->pages_per_zspage;
 		} else
 			migrate_write_unlock(src_zspage);
+		src_zspage = NULL;
 		spin_unlock(&pool->lock);
 		cond_resched();
 		spin_lock(&pool->lock);
+		if (deadline && time_after_eq(jiffies, deadline))
+			break;
 	}
 
 	if (src_zspage) {
@@ -2114,7 +2211,7 @@ unsigned long zs_compact(struct zs_pool *pool)
 		class = pool->size_class[i];
 		if (class->index != i)
 			continue;
-		pages_freed += __zs_compact(pool, class);
+		pages_freed += __zs_compact(pool, class, 0);
 	}
 	atomic_long_add(pages_freed, &pool->stats.pages_compacted);
 	atomic_set(&pool->compaction_in_progress, 0);
@@ -2123,6 +2220,125 @@ unsigned long zs_compact(struct zs_pool *pool)
 }
 EXPORT_SYMBOL_GPL(zs_compact);
 
+/*
+ * Background compaction
+ *
+ * Every bg_compact_interval_ms, each pool compacts the size classes whose
+ * occupancy (obj_used / obj_allocated) dropped below their fragmentation
+ * threshold. A run spends at most bg_compact_budget_ms migrating objects
+ * and the next run resumes with the class where the previous one stopped,
+ * so a heavily fragmented pool is compacted incrementally rather than in
+ * one long pool->lock heavy pass.
+ */
+static LIST_HEAD(zs_pools);
+static DEFINE_MUTEX(zs_pools_lock);
+
+static int zs_bg_compact_interval_set(const char *val,
+				      const struct kernel_param *kp)
+{
+	struct zs_pool *pool;
+	int ret;
+
+	ret = param_set_uint(val, kp);
+	if (ret)
+		return ret;
+
+	/* let every pool pick up the new interval, or stop if it's 0 */
+	mutex_lock(&zs_pools_lock);
+	list_for_each_entry(pool, &zs_pools, list)
+		mod_delayed_work(system_unbound_wq, &pool->compact_work, 0);
+	mutex_unlock(&zs_pools_lock);
+
+	return 0;
+}
+
+static const struct kernel_param_ops zs_bg_compact_interval_ops = {
+	.set = zs_bg_compact_interval_set,
+	.get = param_get_uint,
+};
+module_param_cb(bg_compact_interval_ms, &zs_bg_compact_interval_ops,
+		&zs_bg_compact_interval_ms, 0644);
+
+static bool zs_class_fragmented(struct size_class *class)
+{
+	unsigned int threshold = READ_ONCE(class->compact_threshold);
+	unsigned long obj_allocated = zs_stat_get(class, OBJ_ALLOCATED);
+	unsigned long obj_used = zs_stat_get(class, OBJ_USED);
+
+	if (!threshold)
+		threshold = READ_ONCE(zs_bg_compact_threshold);
+
+	if (!zs_can_compact(class))
+		return false;
+
+	return obj_used * 100 < obj_allocated * threshold;
+}
+
+static void zs_bg_compact_work(struct work_struct *work)
+{
+	struct zs_pool *pool = container_of(to_delayed_work(work),
+					    struct zs_pool, compact_work);
+	unsigned int interval = READ_ONCE(zs_bg_compact_interval_ms);
+	unsigned long deadline, pages_freed = 0;
+	struct size_class *class;
+	int i;
+
+	if (!interval)
+		return;
+
+	/* a foreground zs_compact() is already running, try again later */
+	if (atomic_xchg(&pool->compaction_in_progress, 1))
+		goto requeue;
+
+	deadline = jiffies + max(msecs_to_jiffies(zs_bg_compact_budget_ms), 1UL);
+	for (i = pool->compact_next_class; i >= 0; i--) {
+		class = pool->size_class[i];
+		if (class->index != i)
+			continue;
+		if (!zs_class_fragmented(class))
+			continue;
+
+		pages_freed += __zs_compact(pool, class, deadline);
+		if (time_after_eq(jiffies, deadline))
+			break;
+	}
+	/* resume with the class we ran out of budget on, or start over */
+	pool->compact_next_class = i >= 0 ? i : ZS_SIZE_CLASSES - 1;
+
+	atomic_long_add(pages_freed, &pool->stats.pages_compacted);
+	atomic_long_add(pages_freed, &pool->stats.bg_pages_compacted);
+	atomic_long_inc(&pool->stats.bg_compactions);
+	atomic_set(&pool->compaction_in_progress, 0);
+
+requeue:
+	queue_delayed_work(system_unbound_wq, &pool->compact_work,
+			   msecs_to_jiffies(interval));
+}
+
+/**
+ * zs_set_compact_threshold - Set the background compaction threshold of a class
+ * @pool: pool the class belongs to
+ * @size: object size served by the class, as passed to zs_malloc()
+ * @percent: occupancy below which the class is compacted in the background,
+ *           0 to follow the bg_compact_threshold module parameter
+ *
+ * Returns 0 on success or -EINVAL for an invalid @size or @percent.
+ */
+int zs_set_compact_threshold(struct zs_pool *pool, size_t size,
+			     unsigned int percent)
+{
+	struct size_class *class;
+
+	if (!size || size > ZS_MAX_ALLOC_SIZE - ZS_HANDLE_SIZE || percent > 100)
+		return -EINVAL;
+
+	class = pool->size_class[get_size_class_index(size + ZS_HANDLE_SIZE)];
+	WRITE_ONCE(class->compact_threshold, percent);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(zs_set_compact_threshold);
+
 void zs_pool_stats(struct zs_pool *pool, struct zs_pool_stats *stats)
 {
 	memcpy(stats, &pool->stats, sizeof(struct zs_pool_stats));
@@ -2205,6 +2421,9 @@ struct zs_pool *zs_create_pool(const char *name)
 	init_deferred_free(pool);
 	spin_lock_init(&pool->lock);
 	atomic_set(&pool->compaction_in_progress, 0);
+	INIT_DELAYED_WORK(&pool->compact_work, zs_bg_compact_work);
+	INIT_LIST_HEAD(&pool->list);
+	pool->compact_next_class = ZS_SIZE_CLASSES - 1;
 
 	pool->name = kstrdup(name, GFP_KERNEL);
 	if (!pool->name)
@@ -2294,6 +2513,13 @@ struct zs_pool *zs_create_pool(const char *name)
 	 */
 	zs_register_shrinker(pool);
 
+	mutex_lock(&zs_pools_lock);
+	list_add(&pool->list, &zs_pools);
+	mutex_unlock(&zs_pools_lock);
+	if (READ_ONCE(zs_bg_compact_interval_ms))
+		queue_delayed_work(system_unbound_wq, &pool->compact_work,
+				   msecs_to_jiffies(zs_bg_compact_interval_ms));
+
 	return pool;
 
 err:
@@ -2306,6 +2532,11 @@ void zs_destroy_pool(struct zs_pool *pool)
 {
 	int i;
 
+	mutex_lock(&zs_pools_lock);
+	list_del_init(&pool->list);
+	mutex_unlock(&zs_pools_lock);
+	cancel_delayed_work_sync(&pool->compact_work);
+
 	zs_unregister_shrinker(pool);
 	zs_flush_migration(pool);
 	zs_pool_stat_destroy(pool);
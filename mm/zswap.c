@@ -1108,6 +1108,115 @@ static void zswap_fill_page(void *ptr, unsigned long value)
 	memset_l(page, value, PAGE_SIZE / sizeof(unsigned long));
 }
 
+/*
+ * Compress @page and copy the result, prefixed by the zswap header when the
+ * zpool is evictable, into a new zpool allocation.
+ *
+ * Must be called with acomp_ctx->mutex held, since the per-CPU dstmem is
+ * used as the compression buffer.
+ */
+static int zswap_compress(struct zswap_pool *pool,
+			  struct crypto_acomp_ctx *acomp_ctx,
+			  swp_entry_t swpentry, struct page *page,
+			  unsigned long *handlep, unsigned int *dlenp)
+{
+	struct zswap_header zhdr = { .swpentry = swpentry };
+	struct scatterlist input, output;
+	unsigned int hlen, dlen = PAGE_SIZE;
+	unsigned long handle;
+	char *buf;
+	u8 *dst;
+	gfp_t gfp;
+	int ret;
+
+	dst = acomp_ctx->dstmem;
+	sg_init_table(&input, 1);
+	sg_set_page(&input, page, PAGE_SIZE, 0);
+
+	/* zswap_dstmem is of size (PAGE_SIZE * 2). Reflect same in sg_list */
+	sg_init_one(&output, dst, PAGE_SIZE * 2);
+	acomp_request_set_params(acomp_ctx->req, &input, &output, PAGE_SIZE, dlen);
+	/*
+	 * it maybe looks a little bit silly that we send an asynchronous request,
+	 * then wait for its completion synchronously. This makes the process look
+	 * synchronous in fact.
+	 * Theoretically, acomp supports users send multiple acomp requests in one
+	 * acomp instance, then get those requests done simultaneously. but in this
+	 * case, even a batched store compresses page by page into the one per-cpu
+	 * dstmem, there is no existing method to send the second page before the
+	 * first page is done in one thread doing frontswap.
+	 * but in different threads running on different cpu, we have different
+	 * acomp instance, so multiple threads can do (de)compression in parallel.
+	 */
+	ret = crypto_wait_req(crypto_acomp_compress(acomp_ctx->req), &acomp_ctx->wait);
+	dlen = acomp_ctx->req->dlen;
+
+	if (ret)
+		return -EINVAL;
+
+	/* store */
+	hlen = zpool_evictable(pool->zpool) ? sizeof(zhdr) : 0;
+	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
+	if (zpool_malloc_support_movable(pool->zpool))
+		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
+	ret = zpool_malloc(pool->zpool, hlen + dlen, gfp, &handle);
+	if (ret == -ENOSPC) {
+		zswap_reject_compress_poor++;
+		return ret;
+	}
+	if (ret) {
+		zswap_reject_alloc_fail++;
+		return ret;
+	}
+	buf = zpool_map_handle(pool->zpool, handle, ZPOOL_MM_WO);
+	memcpy(buf, &zhdr, hlen);
+	memcpy(buf + hlen, dst, dlen);
+	zpool_unmap_handle(pool->zpool, handle);
+
+	*handlep = handle;
+	*dlenp = dlen;
+	return 0;
+}
+
+/*
+ * Decompress the data of @entry into @page.
+ *
+ * Must be called with acomp_ctx->mutex held. @tmp is a bounce buffer of at
+ * least entry->length bytes, only used when the zpool doesn't allow
+ * sleeping while a handle is mapped.
+ */
+static int zswap_decompress(struct zswap_entry *entry,
+			    struct crypto_acomp_ctx *acomp_ctx,
+			    struct page *page, u8 *tmp)
+{
+	struct zpool *zpool = entry->pool->zpool;
+	struct scatterlist input, output;
+	unsigned int dlen = PAGE_SIZE;
+	u8 *src;
+	int ret;
+
+	src = zpool_map_handle(zpool, entry->handle, ZPOOL_MM_RO);
+	if (zpool_evictable(zpool))
+		src += sizeof(struct zswap_header);
+
+	if (!zpool_can_sleep_mapped(zpool)) {
+		memcpy(tmp, src, entry->length);
+		src = tmp;
+		zpool_unmap_handle(zpool, entry->handle);
+	}
+
+	sg_init_one(&input, src, entry->length);
+	sg_init_table(&output, 1);
+	sg_set_page(&output, page, PAGE_SIZE, 0);
+	acomp_request_set_params(acomp_ctx->req, &input, &output, entry->length, dlen);
+	ret = crypto_wait_req(crypto_acomp_decompress(acomp_ctx->req), &acomp_ctx->wait);
+
+	if (zpool_can_sleep_mapped(zpool))
+		zpool_unmap_handle(zpool, entry->handle);
+
+	return ret;
+}
+
 /*********************************
 * frontswap hooks
 **********************************/
@@ -1117,19 +1226,15 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 {
 	struct zswap_tree *tree = zswap_trees[type];
 	struct zswap_entry *entry, *dupentry;
-	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
 	struct obj_cgroup *objcg = NULL;
 	struct zswap_pool *pool;
 	int ret;
-	unsigned int hlen, dlen = PAGE_SIZE;
 	unsigned long handle, value;
-	char *buf;
-	u8 *src, *dst;
-	struct zswap_header zhdr = { .swpentry = swp_entry(type, offset) };
-	gfp_t gfp;
+	unsigned int dlen;
+	u8 *src;
 
-	/* THP isn't supported */
+	/* large folios go through zswap_frontswap_store_batch() */
 	if (PageTransHuge(page)) {
 		ret = -EINVAL;
 		goto reject;
@@ -1203,53 +1308,11 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
 
 	mutex_lock(acomp_ctx->mutex);
-
-	dst = acomp_ctx->dstmem;
-	sg_init_table(&input, 1);
-	sg_set_page(&input, page, PAGE_SIZE, 0);
-
-	/* zswap_dstmem is of size (PAGE_SIZE * 2). Reflect same in sg_list */
-	sg_init_one(&output, dst, PAGE_SIZE * 2);
-	acomp_request_set_params(acomp_ctx->req, &input, &output, PAGE_SIZE, dlen);
-	/*
-	 * it maybe looks a little bit silly that we send an asynchronous request,
-	 * then wait for its completion synchronously. This makes the process look
-	 * synchronous in fact.
-	 * Theoretically, acomp supports users send multiple acomp requests in one
-	 * acomp instance, then get those requests done simultaneously. but in this
-	 * case, frontswap actually does store and load page by page, there is no
-	 * existing method to send the second page before the first page is done
-	 * in one thread doing frontswap.
-	 * but in different threads running on different cpu, we have different
-	 * acomp instance, so multiple threads can do (de)compression in parallel.
-	 */
-	ret = crypto_wait_req(crypto_acomp_compress(acomp_ctx->req), &acomp_ctx->wait);
-	dlen = acomp_ctx->req->dlen;
-
-	if (ret) {
-		ret = -EINVAL;
-		goto put_dstmem;
-	}
-
-	/* store */
-	hlen = zpool_evictable(entry->pool->zpool) ? sizeof(zhdr) : 0;
-	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
-	if (zpool_malloc_support_movable(entry->pool->zpool))
-		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
-	ret = zpool_malloc(entry->pool->zpool, hlen + dlen, gfp, &handle);
-	if (ret == -ENOSPC) {
-		zswap_reject_compress_poor++;
-		goto put_dstmem;
-	}
-	if (ret) {
-		zswap_reject_alloc_fail++;
-		goto put_dstmem;
-	}
-	buf = zpool_map_handle(entry->pool->zpool, handle, ZPOOL_MM_WO);
-	memcpy(buf, &zhdr, hlen);
-	memcpy(buf + hlen, dst, dlen);
-	zpool_unmap_handle(entry->pool->zpool, handle);
+	ret = zswap_compress(entry->pool, acomp_ctx, swp_entry(type, offset),
+			     page, &handle, &dlen);
 	mutex_unlock(acomp_ctx->mutex);
+	if (ret)
+		goto put_pool;
 
 	/* populate entry */
 	entry->offset = offset;
@@ -1284,8 +1347,7 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 
 	return 0;
 
-put_dstmem:
-	mutex_unlock(acomp_ctx->mutex);
+put_pool:
 	zswap_pool_put(entry->pool);
 freepage:
 	zswap_entry_cache_free(entry);
@@ -1302,6 +1364,174 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	goto reject;
 }
 
+/*
+ * Attempts to compress and store @nr physically contiguous pages, such as
+ * the subpages of a large folio, at consecutive swap offsets starting at
+ * @offset.
+ *
+ * The pool limit checks, the pool reference and the per-CPU compression
+ * context are taken once for the whole batch, and all entries are made
+ * visible under a single acquisition of the tree lock. Either every page
+ * of the batch is stored, or none is.
+ */
+static int zswap_frontswap_store_batch(unsigned type, pgoff_t offset,
+				       struct page *page, unsigned int nr)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry **entries, *entry, *dupentry;
+	struct crypto_acomp_ctx *acomp_ctx = NULL;
+	struct obj_cgroup *objcg = NULL;
+	struct zswap_pool *pool = NULL;
+	unsigned int i, nr_entries = 0, nr_same = 0;
+	unsigned long value;
+	int ret;
+	u8 *src;
+
+	if (!zswap_enabled || !tree) {
+		ret = -ENODEV;
+		goto reject;
+	}
+
+	objcg = get_obj_cgroup_from_page(page);
+	if (objcg && !obj_cgroup_may_zswap(objcg)) {
+		ret = -ENOMEM;
+		goto reject;
+	}
+
+	/* reclaim space if needed */
+	if (zswap_is_full()) {
+		zswap_pool_limit_hit++;
+		zswap_pool_reached_full = true;
+		goto shrink;
+	}
+
+	if (zswap_pool_reached_full) {
+		if (!zswap_can_accept()) {
+			ret = -ENOMEM;
+			goto reject;
+		} else
+			zswap_pool_reached_full = false;
+	}
+
+	entries = kmalloc_array(nr, sizeof(*entries), GFP_KERNEL | __GFP_NOWARN);
+	if (!entries) {
+		zswap_reject_kmemcache_fail++;
+		ret = -ENOMEM;
+		goto reject;
+	}
+
+	if (zswap_non_same_filled_pages_enabled) {
+		pool = zswap_pool_current_get();
+		if (pool) {
+			acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
+			mutex_lock(acomp_ctx->mutex);
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct page *subpage = nth_page(page, i);
+
+		entry = zswap_entry_cache_alloc(GFP_KERNEL);
+		if (!entry) {
+			zswap_reject_kmemcache_fail++;
+			ret = -ENOMEM;
+			goto freeentries;
+		}
+		entries[nr_entries++] = entry;
+		entry->offset = offset + i;
+		entry->length = 0;
+		entry->objcg = objcg;
+
+		if (zswap_same_filled_pages_enabled) {
+			src = kmap_atomic(subpage);
+			if (zswap_is_page_same_filled(src, &value)) {
+				kunmap_atomic(src);
+				entry->value = value;
+				nr_same++;
+				continue;
+			}
+			kunmap_atomic(src);
+		}
+
+		if (!pool) {
+			ret = -EINVAL;
+			goto freeentries;
+		}
+
+		ret = zswap_compress(pool, acomp_ctx, swp_entry(type, offset + i),
+				     subpage, &entry->handle, &entry->length);
+		if (ret)
+			goto freeentries;
+
+		/* if entry is successfully added, it keeps the reference */
+		kref_get(&pool->kref);
+		entry->pool = pool;
+	}
+
+	if (pool) {
+		mutex_unlock(acomp_ctx->mutex);
+		zswap_pool_put(pool);
+	}
+
+	if (objcg) {
+		/* each entry owns a reference once it is in the tree */
+		if (nr > 1)
+			obj_cgroup_get_many(objcg, nr - 1);
+		for (i = 0; i < nr; i++) {
+			obj_cgroup_charge_zswap(objcg, entries[i]->length);
+			count_objcg_event(objcg, ZSWPOUT);
+		}
+	}
+
+	/* map */
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++) {
+		entry = entries[i];
+		while (zswap_rb_insert(&tree->rbroot, entry, &dupentry) == -EEXIST) {
+			zswap_duplicate_entry++;
+			/* remove from rbtree */
+			zswap_rb_erase(&tree->rbroot, dupentry);
+			zswap_entry_put(tree, dupentry);
+		}
+	}
+	spin_unlock(&tree->lock);
+	kfree(entries);
+
+	/* update stats */
+	atomic_add(nr_same, &zswap_same_filled_pages);
+	atomic_add(nr, &zswap_stored_pages);
+	zswap_update_total_size();
+	count_vm_events(ZSWPOUT, nr);
+
+	return 0;
+
+freeentries:
+	for (i = 0; i < nr_entries; i++) {
+		entry = entries[i];
+		if (entry->length) {
+			zpool_free(pool->zpool, entry->handle);
+			zswap_pool_put(pool);
+		}
+		zswap_entry_cache_free(entry);
+	}
+	if (pool) {
+		mutex_unlock(acomp_ctx->mutex);
+		zswap_pool_put(pool);
+	}
+	kfree(entries);
+reject:
+	if (objcg)
+		obj_cgroup_put(objcg);
+	return ret;
+
+shrink:
+	pool = zswap_pool_last_get();
+	if (pool)
+		queue_work(shrink_wq, &pool->shrink_work);
+	ret = -ENOMEM;
+	goto reject;
+}
+
 /*
  * returns 0 if the page was successfully decompressed
  * return -1 on entry not found or error
@@ -1311,10 +1541,8 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 {
 	struct zswap_tree *tree = zswap_trees[type];
 	struct zswap_entry *entry;
-	struct scatterlist input, output;
 	struct crypto_acomp_ctx *acomp_ctx;
-	u8 *src, *dst, *tmp;
-	unsigned int dlen;
+	u8 *dst, *tmp = NULL;
 	int ret;
 
 	/* find */
@@ -1344,30 +1572,12 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	}
 
 	/* decompress */
-	dlen = PAGE_SIZE;
-	src = zpool_map_handle(entry->pool->zpool, entry->handle, ZPOOL_MM_RO);
-	if (zpool_evictable(entry->pool->zpool))
-		src += sizeof(struct zswap_header);
-
-	if (!zpool_can_sleep_mapped(entry->pool->zpool)) {
-		memcpy(tmp, src, entry->length);
-		src = tmp;
-		zpool_unmap_handle(entry->pool->zpool, entry->handle);
-	}
-
 	acomp_ctx = raw_cpu_ptr(entry->pool->acomp_ctx);
 	mutex_lock(acomp_ctx->mutex);
-	sg_init_one(&input, src, entry->length);
-	sg_init_table(&output, 1);
-	sg_set_page(&output, page, PAGE_SIZE, 0);
-	acomp_request_set_params(acomp_ctx->req, &input, &output, entry->length, dlen);
-	ret = crypto_wait_req(crypto_acomp_decompress(acomp_ctx->req), &acomp_ctx->wait);
+	ret = zswap_decompress(entry, acomp_ctx, page, tmp);
 	mutex_unlock(acomp_ctx->mutex);
 
-	if (zpool_can_sleep_mapped(entry->pool->zpool))
-		zpool_unmap_handle(entry->pool->zpool, entry->handle);
-	else
-		kfree(tmp);
+	kfree(tmp);
 
 	BUG_ON(ret);
 stats:
@@ -1382,6 +1592,95 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 	return ret;
 }
 
+/*
+ * Loads @nr consecutive swap offsets starting at @offset into the physically
+ * contiguous pages starting at @page. All entries are looked up and released
+ * under a single acquisition of the tree lock each, and the compression
+ * context of each pool is only switched when the pool changes.
+ *
+ * returns 0 if every page was successfully decompressed
+ * return -1 if any entry was not found, in which case no page is touched.
+ * Such an entry was written back, so the folio is only partly in zswap and
+ * has to be swapped in page by page; see __frontswap_load().
+ */
+static int zswap_frontswap_load_batch(unsigned type, pgoff_t offset,
+				      struct page *page, unsigned int nr)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct crypto_acomp_ctx *acomp_ctx = NULL;
+	struct zswap_entry **entries, *entry;
+	struct zswap_pool *pool = NULL;
+	u8 *dst, *tmp;
+	unsigned int i;
+	int ret = 0;
+
+	entries = kmalloc_array(nr, sizeof(*entries), GFP_KERNEL | __GFP_NOWARN);
+	if (!entries)
+		return -ENOMEM;
+
+	/* bounce buffer for zpools that can't sleep while mapped */
+	tmp = kmalloc(PAGE_SIZE, GFP_KERNEL | __GFP_NOWARN);
+	if (!tmp) {
+		kfree(entries);
+		return -ENOMEM;
+	}
+
+	/* find */
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++) {
+		entries[i] = zswap_entry_find_get(&tree->rbroot, offset + i);
+		if (!entries[i]) {
+			/* entry was written back */
+			while (i--)
+				zswap_entry_put(tree, entries[i]);
+			spin_unlock(&tree->lock);
+			ret = -1;
+			goto out;
+		}
+	}
+	spin_unlock(&tree->lock);
+
+	for (i = 0; i < nr; i++) {
+		struct page *subpage = nth_page(page, i);
+
+		entry = entries[i];
+		if (!entry->length) {
+			dst = kmap_atomic(subpage);
+			zswap_fill_page(dst, entry->value);
+			kunmap_atomic(dst);
+			continue;
+		}
+
+		/* decompress */
+		if (entry->pool != pool) {
+			if (acomp_ctx)
+				mutex_unlock(acomp_ctx->mutex);
+			pool = entry->pool;
+			acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
+			mutex_lock(acomp_ctx->mutex);
+		}
+		ret = zswap_decompress(entry, acomp_ctx, subpage, tmp);
+		BUG_ON(ret);
+	}
+	if (acomp_ctx)
+		mutex_unlock(acomp_ctx->mutex);
+
+	count_vm_events(ZSWPIN, nr);
+	for (i = 0; i < nr; i++) {
+		if (entries[i]->objcg)
+			count_objcg_event(entries[i]->objcg, ZSWPIN);
+	}
+
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++)
+		zswap_entry_put(tree, entries[i]);
+	spin_unlock(&tree->lock);
+out:
+	kfree(tmp);
+	kfree(entries);
+	return ret;
+}
+
 /* frees an entry in zswap */
 static void zswap_frontswap_invalidate_page(unsigned type, pgoff_t offset)
 {
@@ -1442,7 +1741,9 @@ static void zswap_frontswap_init(unsigned type)
 
 static const struct frontswap_ops zswap_frontswap_ops = {
 	.store = zswap_frontswap_store,
+	.store_batch = zswap_frontswap_store_batch,
 	.load = zswap_frontswap_load,
+	.load_batch = zswap_frontswap_load_batch,
 	.invalidate_page = zswap_frontswap_invalidate_page,
 	.invalidate_area = zswap_frontswap_invalidate_area,
 	.init = zswap_frontswap_init